@@ -5,6 +5,10 @@
 #include <list>
 #include <string>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include "../WriteBack.h"
+#include "../GhostList.h"
 
 class CacheOptimizer {
 private:
@@ -12,21 +16,48 @@ private:
         std::string fileData;
         int frequency;
         bool dirty;
-        std::list<std::string>::iterator lruPos;
+        std::list<std::string>::iterator lruPos;  // Position inside freqLists[frequency]
+        DirtyTracker::Handle dirtyPos{};          // Valid while dirty
     };
 
     int capacity;
     int hits, misses;
+    int minFrequency;  // Lowest frequency that currently has a non-empty bucket
     std::unordered_map<std::string, CacheItem> cache;
-    std::list<std::string> lruOrder;  // For maintaining LRU order
+    // LFU buckets: one recency list per frequency, most recently used at the front
+    std::unordered_map<int, std::list<std::string>> freqLists;
     std::unordered_map<std::string, std::string> mainMemory; // Simulating main memory
+    mutable std::mutex lock;  // Shared with the write-back flusher thread
+    DirtyTracker dirtyFiles;
+    std::unique_ptr<WriteBackJournal> journal;
+    std::vector<DirtyRecord> evictedDirty;  // Written back on eviction, not yet journaled
+    std::unique_ptr<GhostList> ghosts;  // Capacity estimates, when enabled
+    std::unique_ptr<ShadowTier> shadow;
+    long long lookups;  // Since capacity estimates were enabled
+    std::unique_ptr<WriteBackFlusher> flusher;  // Last, so it stops before the rest is destroyed
 
+    void touch(CacheItem &item);  // Moves an item to the next frequency bucket
     void evict();  // Hybrid LRU-LFU eviction method
+    void markDirty(const std::string &filePath, CacheItem &item);
+    std::vector<DirtyRecord> collectDirty(DirtyTracker::Clock::time_point cutoff, size_t excessBytes, bool all);
+    void requeueDirty(std::vector<DirtyRecord> batch);  // Marks a batch the journal failed on dirty again
+    CapacityEstimate estimate() const;  // Caller holds lock
 
 public:
     CacheOptimizer(int cap);
     void accessFile(const std::string &filePath, const std::string &fileData = "", bool write = false);
+    // Starts a background thread that writes dirty files back to main memory (see WriteBack.h),
+    // appending them to journalFile when one is given. Call before sharing the cache between threads.
+    void enableWriteBack(const WriteBackOptions &options = WriteBackOptions(), const std::string &journalFile = "");
+    void flushDirty();  // Writes back every dirty file now
+    WriteBackStats writeBackStats() const;
+    // Counts the hits a cache stepEntries, 2 * stepEntries, ... larger would have added and
+    // one stepEntries smaller would have lost (see GhostList.h)
+    void enableCapacityEstimates(int stepEntries, int steps = 4);
+    CapacityEstimate capacityEstimate() const;
     void printMetrics() const;
+    int hitCount() const { return hits; }
+    int missCount() const { return misses; }
     void displayMainMemory() const;
 };
 
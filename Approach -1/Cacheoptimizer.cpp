@@ -1,7 +1,7 @@
 #include "CacheOptimizer.h"
 
 CacheOptimizer::CacheOptimizer(int cap) 
-    : capacity(cap), hits(0), misses(0) {
+    : capacity(cap), hits(0), misses(0), minFrequency(0), lookups(0) {
     // Initialize main memory with some dummy files (for demonstration)
     mainMemory["file1"] = "Content of file1";
     mainMemory["file2"] = "Content of file2";
@@ -11,76 +11,258 @@ CacheOptimizer::CacheOptimizer(int cap)
 }
 
 void CacheOptimizer::accessFile(const std::string &filePath, const std::string &fileData, bool write) {
+    if (write && flusher) {
+        flusher->throttle();  // Blocks only at the hard dirty limit
+    }
+    std::lock_guard<std::mutex> guard(lock);
     auto it = cache.find(filePath);
 
     if (it != cache.end()) {  // Cache hit
         hits++;
-        it->second.frequency++;  // Increase frequency count
-        lruOrder.erase(it->second.lruPos);  // Update LRU position
-        lruOrder.push_front(filePath);  // Move accessed file to the front
-        it->second.lruPos = lruOrder.begin();
+        touch(it->second);  // Increase frequency count and update LRU position
+        if (shadow) {
+            lookups++;
+            shadow->hit(filePath);
+        }
         
         if (write) {  // If write access, update fileData and set dirty bit
             it->second.fileData = fileData;
-            it->second.dirty = true;
+            markDirty(filePath, it->second);
         }
     } else {  // Cache miss
         misses++;
+        if (ghosts) {
+            lookups++;
+            ghosts->missed(filePath);
+        }
 
-        // Fetch the file from main memory
+        // Fetch the file from main memory (write accesses carry their own data). A file main
+        // memory does not have gets an empty entry there, as it always has.
         std::string data = mainMemory[filePath];
-        
-        if (cache.size() >= capacity) {
+        if (write) {
+            data = fileData;
+        }
+
+        if (capacity <= 0) {
+            return;
+        }
+
+        if (cache.size() >= static_cast<size_t>(capacity)) {
             evict();
         }
 
-        // Add new file to cache
-        lruOrder.push_front(filePath);
-        cache[filePath] = {data, 1, false, lruOrder.begin()};  // Set dirty to false by default
-        if (write) {
-            cache[filePath].fileData = fileData;
-            cache[filePath].dirty = true;  // Set dirty if it's a write access
+        // Add new file to the front of the frequency-1 bucket
+        std::list<std::string> &bucket = freqLists[1];
+        bucket.push_front(filePath);
+        CacheItem &item = cache.emplace(filePath, CacheItem{std::move(data), 1, false, bucket.begin()}).first->second;
+        minFrequency = 1;
+        if (shadow) {
+            shadow->inserted(filePath, 1);
+        }
+        if (write) {  // Dirty only on write access
+            markDirty(filePath, item);
         }
     }
+
+    if (write && flusher) {
+        flusher->dirtied();
+    }
 }
 
-void CacheOptimizer::evict() {
-    // Find the least frequently used file with the least recency (i.e., at the end of lruOrder)
-    auto lru_it = lruOrder.rbegin();
-    std::string toEvict = *lru_it;
-
-    // Identify the file with the lowest frequency among the least recent files
-    for (const auto &entry : cache) {
-        if (entry.second.frequency < cache[toEvict].frequency ||
-            (entry.second.frequency == cache[toEvict].frequency && entry.second.lruPos == lruOrder.end())) {
-            toEvict = entry.first;
+void CacheOptimizer::markDirty(const std::string &filePath, CacheItem &item) {
+    if (item.dirty) {
+        dirtyFiles.resize(item.dirtyPos, item.fileData.size());
+    } else {
+        item.dirty = true;
+        item.dirtyPos = dirtyFiles.add(filePath, item.fileData.size());
+    }
+}
+
+void CacheOptimizer::touch(CacheItem &item) {
+    auto from = freqLists.find(item.frequency);
+    std::list<std::string> &to = freqLists[item.frequency + 1];
+
+    // splice relinks the node, so item.lruPos stays valid and nothing is reallocated
+    to.splice(to.begin(), from->second, item.lruPos);
+    if (from->second.empty()) {
+        freqLists.erase(from);
+        if (minFrequency == item.frequency) {
+            minFrequency = item.frequency + 1;
         }
     }
+    item.frequency++;
+}
+
+void CacheOptimizer::evict() {
+    // The victim is the least frequently used file, and among files with that
+    // frequency the least recently used one (the back of its bucket).
+    //
+    // This preserves the tie-breaking of the previous full scan, which started
+    // from the global LRU tail and only replaced it with a strictly less
+    // frequent file: whenever the LRU tail was among the least frequent files
+    // it was evicted, and it is still the back of the lowest bucket. When it
+    // was not, the scan took whichever least frequent file the hash map
+    // iterated first; that choice is now the least recent of them instead.
+    auto bucket = freqLists.find(minFrequency);
+    std::string toEvict = std::move(bucket->second.back());
+    bucket->second.pop_back();
+    if (bucket->second.empty()) {
+        freqLists.erase(bucket);
+    }
+
+    auto it = cache.find(toEvict);
+    if (ghosts) {
+        ghosts->evicted(toEvict, 1);
+        shadow->removed(toEvict);
+    }
 
     // Check if the file is dirty, write back to main memory if needed
-    if (cache[toEvict].dirty) {
-        mainMemory[toEvict] = cache[toEvict].fileData;  // Write back to main memory
+    if (it->second.dirty) {
+        if (journal) {
+            evictedDirty.push_back({toEvict, it->second.fileData, it->second.dirtyPos->since});
+        }
+        dirtyFiles.remove(it->second.dirtyPos);
+        mainMemory[toEvict] = std::move(it->second.fileData);  // Write back to main memory
         std::cout << "Evicted and wrote back: " << toEvict << " (Hybrid LRU-LFU, Dirty)" << std::endl;
     } else {
         std::cout << "Evicted: " << toEvict << " (Hybrid LRU-LFU)" << std::endl;
     }
 
-    // Remove the file from cache and LRU list
-    lruOrder.erase(cache[toEvict].lruPos);
-    cache.erase(toEvict);
+    // Remove the file from cache (its bucket node is already gone)
+    cache.erase(it);
+}
+
+void CacheOptimizer::enableWriteBack(const WriteBackOptions &options, const std::string &journalFile) {
+    if (flusher) {
+        return;
+    }
+    if (!journalFile.empty()) {
+        journal = std::make_unique<WriteBackJournal>(journalFile);
+    }
+    flusher = std::make_unique<WriteBackFlusher>(
+        options, dirtyFiles,
+        [this](DirtyTracker::Clock::time_point cutoff, size_t excessBytes, bool all) {
+            return collectDirty(cutoff, excessBytes, all);
+        },
+        [this](const std::vector<DirtyRecord> &batch) {
+            if (journal) {
+                journal->append(batch);
+            }
+        },
+        [this](std::vector<DirtyRecord> batch) { requeueDirty(std::move(batch)); });
+}
+
+// Runs on the flusher thread. Main memory is updated under the cache lock, so a miss never
+// reads data older than what the cache just dropped; only the journal write happens outside.
+std::vector<DirtyRecord> CacheOptimizer::collectDirty(DirtyTracker::Clock::time_point cutoff, size_t excessBytes, bool all) {
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<DirtyRecord> records = std::move(evictedDirty);
+    evictedDirty.clear();
+    for (DirtyTracker::Entry &entry : dirtyFiles.takeDue(cutoff, excessBytes, all)) {
+        CacheItem &item = cache.find(entry.path)->second;
+        item.dirty = false;
+        mainMemory[entry.path] = item.fileData;
+        records.push_back({std::move(entry.path), item.fileData, entry.since, entry.bytes});
+    }
+    return records;
+}
+
+// Runs on the flusher thread when a batch could not be journaled. A file still cached is
+// dirty again from its original time (or its current dirty time, if older); one evicted
+// meanwhile is already in main memory and only waits for the journal again.
+void CacheOptimizer::requeueDirty(std::vector<DirtyRecord> batch) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (DirtyRecord &record : batch) {
+        auto it = cache.find(record.path);
+        if (it == cache.end()) {
+            // A version evicted after this batch was collected is newer and supersedes it
+            bool superseded = std::any_of(evictedDirty.begin(), evictedDirty.end(),
+                                          [&](const DirtyRecord &pending) { return pending.path == record.path; });
+            if (!superseded) {
+                record.trackedBytes = 0;  // Released by the flusher when this batch failed
+                evictedDirty.push_back(std::move(record));
+            }
+            continue;
+        }
+        CacheItem &item = it->second;
+        auto since = record.since;
+        if (item.dirty) {
+            since = std::min(since, item.dirtyPos->since);
+            dirtyFiles.remove(item.dirtyPos);
+        }
+        item.dirty = true;
+        item.dirtyPos = dirtyFiles.restore(record.path, item.fileData.size(), since);
+    }
+}
+
+void CacheOptimizer::flushDirty() {
+    if (flusher) {
+        flusher->flushAll();
+        return;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    for (const DirtyTracker::Entry &entry : dirtyFiles.takeDue(DirtyTracker::Clock::now(), 0, true)) {
+        CacheItem &item = cache.find(entry.path)->second;
+        item.dirty = false;
+        mainMemory[entry.path] = item.fileData;
+        dirtyFiles.written(entry.bytes);
+    }
+}
+
+WriteBackStats CacheOptimizer::writeBackStats() const {
+    return flusher ? flusher->statistics() : WriteBackStats();
+}
+
+void CacheOptimizer::enableCapacityEstimates(int stepEntries, int steps) {
+    std::lock_guard<std::mutex> guard(lock);
+    size_t step = stepEntries > 0 ? stepEntries : 1;
+    ghosts = std::make_unique<GhostList>(step, steps);
+    shadow = std::make_unique<ShadowTier>(capacity > static_cast<int>(step) ? capacity - step : 0);
+    lookups = 0;
+    for (const auto &bucket : freqLists) {
+        for (const std::string &filePath : bucket.second) {
+            shadow->inserted(filePath, 1);
+        }
+    }
+}
+
+CapacityEstimate CacheOptimizer::capacityEstimate() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return estimate();
+}
+
+CapacityEstimate CacheOptimizer::estimate() const {
+    CapacityEstimate estimate;
+    if (!ghosts) {
+        return estimate;
+    }
+    estimate.step = ghosts->stepSize();
+    estimate.extraHits = ghosts->extraHits();
+    estimate.lostHits = shadow->lostHits();
+    estimate.accesses = lookups;
+    return estimate;
 }
 
 void CacheOptimizer::printMetrics() const {
+    std::lock_guard<std::mutex> guard(lock);
     double hitRate = (double)hits / (hits + misses) * 100;
     double missRate = (double)misses / (hits + misses) * 100;
 
     std::cout << "Cache Performance Metrics:" << std::endl;
     std::cout << "Hits: " << hits << " | Misses: " << misses << std::endl;
     std::cout << "Hit Rate: " << hitRate << "% | Miss Rate: " << missRate << "%" << std::endl;
+    if (flusher) {
+        flusher->statistics().print();
+    }
+    if (ghosts) {
+        std::cout << "Capacity what-if over " << lookups << " lookups:" << std::endl;
+        estimate().print(std::cout, "entries");
+    }
 }
 
 // New: Display the contents of main memory
 void CacheOptimizer::displayMainMemory() const {
+    std::lock_guard<std::mutex> guard(lock);
     std::cout << "Main Memory Contents:" << std::endl;
     for (const auto &entry : mainMemory) {
         std::cout << entry.first << ": " << entry.second << std::endl;
@@ -0,0 +1,289 @@
+#include "FlatCacheOptimizer.h"
+#include <algorithm>
+#include <iostream>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+FlatCacheOptimizer::FlatCacheOptimizer(int cap)
+    : capacity(cap), hits(0), misses(0), occupied(0), used(0), lowest(none) {
+    size_t entries = cap > 0 ? static_cast<size_t>(cap) : 0;
+
+    // At most 3/4 full with live entries, so at least 1/8 of the slots can hold
+    // tombstones before a rebuild is needed
+    size_t slotCount = groupSize;
+    while (slotCount * 3 / 4 < entries) {
+        slotCount *= 2;
+    }
+    control.assign(slotCount, emptySlot);
+    slots.assign(slotCount, none);
+    groupMask = slotCount / groupSize - 1;
+    maxLoad = slotCount * 7 / 8;
+
+    keys.resize(entries);
+    data.resize(entries);
+    hashes.resize(entries);
+    slotOf.resize(entries);
+    bucketOf.resize(entries);
+    prev.resize(entries);
+    next.resize(entries);
+    dirty.resize(entries);
+    buckets.reserve(entries + 1);
+
+    // Initialize main memory with some dummy files (for demonstration)
+    mainMemory["file1"] = "Content of file1";
+    mainMemory["file2"] = "Content of file2";
+    mainMemory["file3"] = "Content of file3";
+    mainMemory["file4"] = "Content of file4";
+    mainMemory["file5"] = "Content of file5";
+}
+
+void FlatCacheOptimizer::accessFile(std::string_view filePath, const std::string &fileData, bool write) {
+    uint64_t hash = hashOf(filePath);
+    Index entry = find(filePath, hash);
+
+    if (entry != none) {  // Cache hit
+        hits++;
+        touch(entry);  // Increase frequency count and update LRU position
+
+        if (write) {  // If write access, update fileData and set dirty bit
+            data[entry] = fileData;
+            dirty[entry] = true;
+        }
+        return;
+    }
+
+    // Cache miss
+    misses++;
+    if (capacity <= 0) {
+        return;
+    }
+    entry = used < static_cast<Index>(capacity) ? used++ : evict();
+
+    // Reuses the victim's buffers when they are large enough
+    keys[entry].assign(filePath.data(), filePath.size());
+    hashes[entry] = hash;
+    if (write) {  // Write accesses carry their own data
+        data[entry] = fileData;
+    } else {
+        auto mem = mainMemory.find(keys[entry]);
+        if (mem != mainMemory.end()) {
+            data[entry] = mem->second;
+        } else {
+            data[entry].clear();
+        }
+    }
+    dirty[entry] = write;  // Dirty only on write access
+    insertSlot(entry);
+
+    // Add the new file to the front of the frequency-1 bucket
+    Index bucket = lowest != none && buckets[lowest].frequency == 1 ? lowest : newBucket(1, none, lowest);
+    pushFront(bucket, entry);
+}
+
+uint64_t FlatCacheOptimizer::hashOf(std::string_view key) {
+    return std::hash<std::string_view>()(key);
+}
+
+// Bit i of the result is set when control byte i of the group matches
+uint32_t FlatCacheOptimizer::matchTag(const int8_t *group, int8_t tag) {
+#if defined(__SSE2__)
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(tag))));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < groupSize; ++i) {
+        mask |= static_cast<uint32_t>(group[i] == tag) << i;
+    }
+    return mask;
+#endif
+}
+
+uint32_t FlatCacheOptimizer::matchFree(const int8_t *group) {
+#if defined(__SSE2__)
+    // Empty and deleted are the only control bytes with the sign bit set
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(group))));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < groupSize; ++i) {
+        mask |= static_cast<uint32_t>(group[i] < 0) << i;
+    }
+    return mask;
+#endif
+}
+
+uint32_t FlatCacheOptimizer::matchEmpty(const int8_t *group) {
+    return matchTag(group, emptySlot);
+}
+
+// Groups are probed in triangular order, which visits every group of a power-of-two
+// table; a group with an empty slot ends the search, and one always exists
+FlatCacheOptimizer::Index FlatCacheOptimizer::find(std::string_view key, uint64_t hash) const {
+    int8_t tag = static_cast<int8_t>(hash & 0x7F);
+    size_t group = (hash >> 7) & groupMask;
+    for (size_t probe = 1;; ++probe) {
+        const int8_t *ctrl = &control[group * groupSize];
+        for (uint32_t matches = matchTag(ctrl, tag); matches; matches &= matches - 1) {
+            Index entry = slots[group * groupSize + __builtin_ctz(matches)];
+            if (hashes[entry] == hash && keys[entry] == key) {
+                return entry;
+            }
+        }
+        if (matchEmpty(ctrl)) {
+            return none;
+        }
+        group = (group + probe) & groupMask;
+    }
+}
+
+void FlatCacheOptimizer::insertSlot(Index entry) {
+    if (occupied >= maxLoad) {
+        // Too many tombstones: reinsert every live entry into a clean table
+        std::fill(control.begin(), control.end(), emptySlot);
+        occupied = 0;
+        for (Index other = 0; other < used; ++other) {
+            if (other != entry) {
+                placeSlot(other);
+            }
+        }
+    }
+    placeSlot(entry);
+}
+
+void FlatCacheOptimizer::placeSlot(Index entry) {
+    uint64_t hash = hashes[entry];
+    size_t group = (hash >> 7) & groupMask;
+    for (size_t probe = 1;; ++probe) {
+        uint32_t free = matchFree(&control[group * groupSize]);
+        if (free) {
+            size_t slot = group * groupSize + __builtin_ctz(free);
+            if (control[slot] == emptySlot) {
+                occupied++;
+            }
+            control[slot] = static_cast<int8_t>(hash & 0x7F);
+            slots[slot] = entry;
+            slotOf[entry] = static_cast<Index>(slot);
+            return;
+        }
+        group = (group + probe) & groupMask;
+    }
+}
+
+// A group that still has an empty slot has never been full since the last rebuild, so
+// no probe ever went past it and the slot can be emptied instead of left as a tombstone
+void FlatCacheOptimizer::eraseSlot(Index entry) {
+    size_t slot = slotOf[entry];
+    if (matchEmpty(&control[slot & ~(groupSize - 1)])) {
+        control[slot] = emptySlot;
+        occupied--;
+    } else {
+        control[slot] = deletedSlot;
+    }
+}
+
+FlatCacheOptimizer::Index FlatCacheOptimizer::newBucket(uint32_t frequency, Index lower, Index higher) {
+    Index bucket;
+    if (!freeBuckets.empty()) {
+        bucket = freeBuckets.back();
+        freeBuckets.pop_back();
+    } else {
+        bucket = static_cast<Index>(buckets.size());
+        buckets.emplace_back();
+    }
+    buckets[bucket] = Bucket{frequency, none, none, lower, higher};
+    if (lower != none) {
+        buckets[lower].higher = bucket;
+    } else {
+        lowest = bucket;
+    }
+    if (higher != none) {
+        buckets[higher].lower = bucket;
+    }
+    return bucket;
+}
+
+void FlatCacheOptimizer::releaseBucket(Index bucket) {
+    Bucket &b = buckets[bucket];
+    if (b.lower != none) {
+        buckets[b.lower].higher = b.higher;
+    } else {
+        lowest = b.higher;
+    }
+    if (b.higher != none) {
+        buckets[b.higher].lower = b.lower;
+    }
+    freeBuckets.push_back(bucket);
+}
+
+void FlatCacheOptimizer::pushFront(Index bucket, Index entry) {
+    Bucket &b = buckets[bucket];
+    prev[entry] = none;
+    next[entry] = b.head;
+    if (b.head != none) {
+        prev[b.head] = entry;
+    } else {
+        b.tail = entry;
+    }
+    b.head = entry;
+    bucketOf[entry] = bucket;
+}
+
+void FlatCacheOptimizer::unlink(Index entry) {
+    Bucket &b = buckets[bucketOf[entry]];
+    if (prev[entry] != none) {
+        next[prev[entry]] = next[entry];
+    } else {
+        b.head = next[entry];
+    }
+    if (next[entry] != none) {
+        prev[next[entry]] = prev[entry];
+    } else {
+        b.tail = prev[entry];
+    }
+    if (b.head == none) {
+        releaseBucket(bucketOf[entry]);
+    }
+}
+
+void FlatCacheOptimizer::touch(Index entry) {
+    Index from = bucketOf[entry];
+    Index to = buckets[from].higher;
+    if (to == none || buckets[to].frequency != buckets[from].frequency + 1) {
+        to = newBucket(buckets[from].frequency + 1, from, to);
+    }
+    unlink(entry);
+    pushFront(to, entry);
+}
+
+// The victim is the least recently used file among the least frequently used ones,
+// the same choice CacheOptimizer makes
+FlatCacheOptimizer::Index FlatCacheOptimizer::evict() {
+    Index victim = buckets[lowest].tail;
+    unlink(victim);
+    eraseSlot(victim);
+
+    // Check if the file is dirty, write back to main memory if needed
+    if (dirty[victim]) {
+        mainMemory[keys[victim]] = std::move(data[victim]);  // Write back to main memory
+        std::cout << "Evicted and wrote back: " << keys[victim] << " (Hybrid LRU-LFU, Dirty)" << std::endl;
+    } else {
+        std::cout << "Evicted: " << keys[victim] << " (Hybrid LRU-LFU)" << std::endl;
+    }
+    return victim;
+}
+
+void FlatCacheOptimizer::printMetrics() const {
+    double hitRate = (double)hits / (hits + misses) * 100;
+    double missRate = (double)misses / (hits + misses) * 100;
+
+    std::cout << "Cache Performance Metrics:" << std::endl;
+    std::cout << "Hits: " << hits << " | Misses: " << misses << std::endl;
+    std::cout << "Hit Rate: " << hitRate << "% | Miss Rate: " << missRate << "%" << std::endl;
+}
+
+void FlatCacheOptimizer::displayMainMemory() const {
+    std::cout << "Main Memory Contents:" << std::endl;
+    for (const auto &entry : mainMemory) {
+        std::cout << entry.first << ": " << entry.second << std::endl;
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef FLAT_CACHE_OPTIMIZER_H
+#define FLAT_CACHE_OPTIMIZER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// The hybrid LRU-LFU policy of CacheOptimizer on a flat core, allocated once for
+// `capacity` entries so that a hit follows indices into a few arrays instead of
+// chasing hash-node and list-node pointers.
+//
+// Entries are numbered 0..capacity-1 and stored as parallel arrays: key, data and
+// hash, then the metadata a hit updates (frequency bucket, and the prev/next links of
+// the bucket's recency list as 32-bit indices). Keys are found through an
+// open-addressing table in the style of Swiss tables: one control byte per slot holds
+// 7 bits of the hash (or empty/deleted), 16 control bytes are matched at once with
+// SSE2, and a parallel slot array holds the entry number.
+//
+// Dirty files are written back to main memory when evicted, as CacheOptimizer does
+// without enableWriteBack; there is no background flusher. Not thread-safe.
+class FlatCacheOptimizer {
+public:
+    FlatCacheOptimizer(int cap);
+    void accessFile(std::string_view filePath, const std::string &fileData = "", bool write = false);
+    void printMetrics() const;
+    int hitCount() const { return hits; }
+    int missCount() const { return misses; }
+    void displayMainMemory() const;
+
+private:
+    using Index = uint32_t;
+    static constexpr Index none = UINT32_MAX;
+    static constexpr size_t groupSize = 16;
+    static constexpr int8_t emptySlot = -128;
+    static constexpr int8_t deletedSlot = -2;
+
+    // Entries accessed `frequency` times, most recently used at the head
+    struct Bucket {
+        uint32_t frequency;
+        Index head, tail;
+        Index lower, higher;  // Neighbouring buckets, in ascending frequency
+    };
+
+    int capacity;
+    int hits, misses;
+
+    // Hash table, a power-of-two number of slots in aligned groups of 16
+    std::vector<int8_t> control;  // emptySlot, deletedSlot, or the low 7 bits of the hash
+    std::vector<Index> slots;     // Entry number per slot
+    size_t groupMask;
+    size_t occupied;              // Live and deleted slots
+    size_t maxLoad;               // Occupied slots allowed before a rebuild
+
+    // Entries
+    std::vector<std::string> keys, data;
+    std::vector<uint64_t> hashes;
+    std::vector<Index> slotOf;    // Table slot of each entry
+    std::vector<Index> bucketOf;
+    std::vector<Index> prev, next;
+    std::vector<uint8_t> dirty;
+    Index used;                   // Entries handed out so far; later misses reuse the victim's
+
+    // Frequency buckets, at most one per entry plus the one being created
+    std::vector<Bucket> buckets;
+    std::vector<Index> freeBuckets;
+    Index lowest;                 // Bucket holding the eviction victim at its tail
+
+    std::unordered_map<std::string, std::string> mainMemory; // Simulating main memory
+
+    static uint64_t hashOf(std::string_view key);
+    static uint32_t matchTag(const int8_t *group, int8_t tag);
+    static uint32_t matchFree(const int8_t *group);   // Empty or deleted
+    static uint32_t matchEmpty(const int8_t *group);
+
+    Index find(std::string_view key, uint64_t hash) const;  // Entry number, or none
+    void insertSlot(Index entry);
+    void placeSlot(Index entry);
+    void eraseSlot(Index entry);
+
+    Index newBucket(uint32_t frequency, Index lower, Index higher);
+    void releaseBucket(Index bucket);
+    void pushFront(Index bucket, Index entry);
+    void unlink(Index entry);  // Also releases the bucket if this empties it
+    void touch(Index entry);   // Moves an entry to the bucket for frequency + 1
+    Index evict();             // Frees the victim and returns its entry number
+};
+
+#endif // FLAT_CACHE_OPTIMIZER_H
@@ -0,0 +1,178 @@
+// Microbenchmark: FlatCacheOptimizer vs. the node-based CacheOptimizer.
+// Build: g++ -O2 -std=c++17 -pthread flat_benchmark.cpp Cacheoptimizer.cpp FlatCacheOptimizer.cpp -o flat_benchmark
+//
+// For each cache size it reports heap bytes per cached entry, then runs two phases:
+// hits only (random resident keys) and a mixed trace (skewed keys over twice the
+// capacity, 10% writes). Each phase is timed and, where perf_event_open is allowed
+// (see /proc/sys/kernel/perf_event_paranoid), counts instructions, cycles and
+// last-level cache misses per operation. Both caches implement the same policy, so
+// they must report the same number of hits.
+#include "CacheOptimizer.h"
+#include "FlatCacheOptimizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <malloc.h>
+#include <random>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Instructions, cycles and cache misses of the calling thread, in user space only
+class PerfCounters {
+public:
+    PerfCounters() {
+        const uint64_t configs[count] = {PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES};
+        for (int i = 0; i < count; ++i) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+    }
+
+    ~PerfCounters() {
+        for (int fd : fds) {
+            if (fd >= 0) close(fd);
+        }
+    }
+
+    void start() {
+        for (int fd : fds) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+
+    // Counter values since start(), -1 where the counter is unavailable
+    std::vector<long long> stop() {
+        std::vector<long long> values;
+        for (int fd : fds) {
+            long long value = -1;
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+                if (read(fd, &value, sizeof(value)) != sizeof(value)) value = -1;
+            }
+            values.push_back(value);
+        }
+        return values;
+    }
+
+private:
+    static constexpr int count = 3;
+    int fds[count];
+};
+
+struct Access {
+    int key;
+    bool write;
+};
+
+size_t heapInUse() {
+    return mallinfo2().uordblks;
+}
+
+void printRow(size_t entries, const char *impl, const char *phase, size_t ops, double seconds,
+              const std::vector<long long> &counters, int hits) {
+    std::cerr << std::left << std::setw(10) << entries << std::setw(8) << impl << std::setw(8) << phase
+              << std::right << std::fixed << std::setprecision(1) << std::setw(10) << seconds * 1e9 / ops;
+    for (long long value : counters) {
+        if (value < 0) {
+            std::cerr << std::setw(10) << "n/a";
+        } else {
+            std::cerr << std::setw(10) << std::setprecision(2) << (double)value / ops;
+        }
+    }
+    std::cerr << std::setw(12) << hits << std::endl;
+}
+
+template <typename Cache>
+void benchmark(const char *name, size_t entries, const std::vector<std::string> &keys,
+               const std::vector<int> &hitTrace, const std::vector<Access> &mixedTrace) {
+    const std::string payload = "benchmark payload";
+    PerfCounters perf;
+
+    size_t heapBefore = heapInUse();
+    Cache *cache = new Cache(static_cast<int>(entries));
+    for (size_t i = 0; i < entries; ++i) {
+        cache->accessFile(keys[i]);
+    }
+    double bytesPerEntry = (double)(heapInUse() - heapBefore) / entries;
+
+    // Hits only: every key below `entries` is resident
+    int hitsBefore = cache->hitCount();
+    perf.start();
+    auto start = std::chrono::steady_clock::now();
+    for (int key : hitTrace) {
+        cache->accessFile(keys[key]);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printRow(entries, name, "hit", hitTrace.size(), seconds, perf.stop(), cache->hitCount() - hitsBefore);
+
+    hitsBefore = cache->hitCount();
+    perf.start();
+    start = std::chrono::steady_clock::now();
+    for (const Access &a : mixedTrace) {
+        cache->accessFile(keys[a.key], payload, a.write);
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printRow(entries, name, "mixed", mixedTrace.size(), seconds, perf.stop(), cache->hitCount() - hitsBefore);
+
+    std::cerr << std::left << std::setw(10) << entries << std::setw(8) << name << std::setw(8) << "memory"
+              << std::right << std::setprecision(1) << std::setw(10) << bytesPerEntry << " bytes/entry" << std::endl;
+    delete cache;
+}
+
+int main(int argc, char *argv[]) {
+    const size_t operations = argc > 1 ? std::stoul(argv[1]) : 2000000;
+    const std::vector<size_t> sizes = {1000, 100000, 1000000};
+
+    // Eviction messages are part of both implementations; keep them out of the timing
+    std::cout.setstate(std::ios::badbit);
+
+    std::cerr << std::left << std::setw(10) << "Entries" << std::setw(8) << "Impl" << std::setw(8) << "Phase"
+              << std::right << std::setw(10) << "ns/op" << std::setw(10) << "instr/op" << std::setw(10) << "cyc/op"
+              << std::setw(10) << "LLCmiss" << std::setw(12) << "Hits" << std::endl;
+
+    for (size_t entries : sizes) {
+        std::vector<std::string> keys;
+        keys.reserve(entries * 2);
+        for (size_t i = 0; i < entries * 2; ++i) {
+            keys.push_back("file" + std::to_string(i));
+        }
+
+        std::mt19937_64 gen(42);
+        std::uniform_int_distribution<int> resident(0, static_cast<int>(entries) - 1);
+        std::vector<int> hitTrace(operations);
+        for (int &key : hitTrace) {
+            key = resident(gen);
+        }
+
+        // Same mix as benchmark.cpp: half the accesses skewed towards low ids, half uniform
+        std::geometric_distribution<int> hot(4.0 / entries);
+        std::uniform_int_distribution<int> any(0, static_cast<int>(entries * 2) - 1);
+        std::bernoulli_distribution coin(0.5), writeCoin(0.1);
+        std::vector<Access> mixedTrace(operations);
+        for (auto &a : mixedTrace) {
+            int key = coin(gen) ? hot(gen) : any(gen);
+            a.key = key < static_cast<int>(entries * 2) ? key : any(gen);
+            a.write = writeCoin(gen);
+        }
+
+        benchmark<CacheOptimizer>("node", entries, keys, hitTrace, mixedTrace);
+        benchmark<FlatCacheOptimizer>("flat", entries, keys, hitTrace, mixedTrace);
+    }
+
+    return 0;
+}
@@ -27,27 +27,28 @@
 //     return 0;
 //}
 #include "CacheOptimizer.h"
+#include "../Benchmark/WorkloadGenerator.h"
 #include <iostream>
-#include <cstdlib>
-#include <ctime>
 #include <vector>
 
-int main() {
+// Usage: main [workload spec] [accesses], e.g. main "hotspot:keys=5,phase=5,write=0.2" 30
+int main(int argc, char *argv[]) {
     CacheOptimizer cache(3);  // Set cache capacity to 3
+    cache.enableCapacityEstimates(1, 2);  // What one file more or less of capacity would change
 
-    // Seed the random number generator
-    std::srand(static_cast<unsigned int>(std::time(nullptr)));
+    // Deterministic, skewed access stream so runs can be compared (see WorkloadSpec::parse)
+    WorkloadGenerator workload(WorkloadSpec::parse(argc > 1 ? argv[1] : "zipf:keys=5,skew=1.0,write=0.5,seed=1"));
+    int accesses = argc > 2 ? std::stoi(argv[2]) : 15;
 
     // Predefined list of files in main memory
     std::vector<std::string> files = {"file1", "file2", "file3", "file4", "file5"};
 
-    // Simulate 15 random file accesses
-    for (int i = 0; i < 15; ++i) {
-        // Randomly choose a file to access
-        std::string fileToAccess = files[std::rand() % files.size()];
-
-        // Randomly decide if the access is a read or write
-        bool isWriteAccess = std::rand() % 2;
+    // Simulate the file accesses
+    for (int i = 0; i < accesses; ++i) {
+        // Draw the next file and access type from the workload
+        WorkloadOperation op = workload.next();
+        std::string fileToAccess = files[op.key % files.size()];
+        bool isWriteAccess = op.write;
         std::string fileData = "Random content for " + fileToAccess;
 
         // Access the file, specifying read or write mode
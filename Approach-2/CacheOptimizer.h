@@ -4,38 +4,105 @@
 #include <unordered_map>
 #include <list>
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <vector>
 #include <random>
 #include <chrono>
+#include <memory>
+#include <mutex>
+#include "../WriteBack.h"
+#include "PathInterner.h"
+#include "SuccessorTable.h"
+#include "MissRatioCurve.h"
+
+// Sizing from the miss ratio curve (see MissRatioCurve.h). Every `interval` accesses the
+// cache picks the smaller of: the smallest size predicted to reach targetHitRatio, and the
+// size with the best predicted hit ratio net of minMarginalGain per entry (so an entry is
+// only worth adding if it adds at least that much hit ratio). The capacity then moves
+// towards it, by at most maxStep of itself, unless the change is within hysteresis.
+struct SizingOptions {
+    bool enabled = true;
+    double sampleRate = 0.01;       // Share of files whose accesses feed the curve; sizes
+                                    // closer than about 1 / sampleRate entries look alike
+    double targetHitRatio = 0.9;
+    double minMarginalGain = 1e-4;  // Hit ratio an entry has to add to be worth its memory
+    int minCapacity = 2;
+    int maxCapacity = 1 << 20;      // Memory budget, in entries
+    int interval = 1000;            // Accesses between sizing decisions
+    double minSamples = 100;        // Sampled accesses the curve needs before the first decision
+    double hysteresis = 0.05;       // Changes up to this fraction of the capacity are skipped
+    double maxStep = 0.5;           // Largest change per decision, as a fraction of the capacity
+    double halfLife = 100000;       // Sampled accesses after which older ones count half
+};
+
+// Prefetching of the files that usually follow the one being accessed (see SuccessorTable.h)
+struct PrefetchOptions {
+    bool enabled = true;
+    double confidence = 0.5;      // Lowest successor probability worth prefetching
+    double decay = 0.9;           // Weight an observation keeps at each later one from the same file
+    double minObservations = 2;   // Decayed accesses a file needs before its successors are trusted
+    int maxPrefetches = 1;        // Files prefetched per access
+};
 
 class CacheOptimizer {
 public:
+    using FileId = PathInterner::Id;
+
     struct CacheItem {
         std::string fileData;
         int frequency;
         bool dirty;
-        std::list<std::string>::iterator lruPos;
+        std::list<FileId>::iterator lruPos;
+        DirtyTracker::Handle dirtyPos{};  // Valid while dirty
+        bool prefetched = false;        // Brought in by a prefetch and not accessed since
     };
 
     int capacity;
     int hits, misses, evictions, writebacks;
-    std::unordered_map<std::string, CacheItem> cache;
-    std::list<std::string> lruOrder;  // For maintaining LRU order
-    std::unordered_map<std::string, std::string> mainMemory; // Simulating main memory
-    std::unordered_map<std::string, std::vector<std::string>> accessPatterns; // Tracks access patterns for proactive caching
-    std::unordered_map<std::string, int> accessCounts; // Tracks how often a file was accessed
-    std::chrono::steady_clock::time_point lastPatternAnalysisTime;
-    int patternAnalysisInterval;  // Time in seconds to re-analyze access patterns
-    int adaptiveCacheThreshold;  // Threshold to resize the cache dynamically
-
-    void evict();  // Hybrid LRU-LFU eviction method
-    void analyzeAccessPatterns();  // Analyzes file access patterns periodically
+    PathInterner paths;  // Paths are interned once per access; everything below is keyed by ID
+    std::unordered_map<FileId, CacheItem> cache;
+    std::list<FileId> lruOrder;  // For maintaining LRU order
+    std::unordered_map<FileId, std::string> mainMemory; // Simulating main memory
+    std::vector<int> accessCounts; // Tracks how often a file was accessed, indexed by ID
+
+    // Adaptive sizing
+    SizingOptions sizing;
+    MissRatioCurve missRatioCurve;
+    int accessesSinceSizing;
+
+    // Prefetching: which file follows which, and how well the prefetches paid off
+    PrefetchOptions prefetch;
+    SuccessorTable successors;
+    FileId lastAccess;
+    std::vector<SuccessorTable::Prediction> predictions;  // Reused between accesses
+    long long prefetchesIssued, prefetchesUsed, prefetchesWasted;
+    long long prefetchedBytes, wastedPrefetchBytes;  // Wasted: evicted before any access
+
+    mutable std::mutex lock;  // Shared with the write-back flusher thread
+    DirtyTracker dirtyFiles;
+    std::unique_ptr<WriteBackJournal> journal;
+    std::vector<DirtyRecord> evictedDirty;  // Written back on eviction, not yet journaled
+    std::unique_ptr<WriteBackFlusher> flusher;  // Last, so it stops before the rest is destroyed
+
+    void evict(FileId keep = PathInterner::none);  // Hybrid LRU-LFU eviction method, never picks `keep`
+    CacheItem &insert(FileId file, std::string data, FileId keep = PathInterner::none);  // Evicts down to capacity first
+    void prefetchSuccessors(FileId file);
+    void markDirty(FileId file, CacheItem &item);
+    std::vector<DirtyRecord> collectDirty(DirtyTracker::Clock::time_point cutoff, size_t excessBytes, bool all);
+    void requeueDirty(std::vector<DirtyRecord> batch);  // Marks a batch the journal failed on dirty again
     void adjustCacheSize();  // Adjusts the cache size dynamically based on access patterns
+    int chooseCapacity() const;  // Size the miss ratio curve calls for, see SizingOptions
 
 public:
-    CacheOptimizer(int cap, int patternInterval = 30, int adaptiveThreshold = 100);
-    void accessFile(const std::string &filePath, const std::string &fileData = "", bool write = false);
+    CacheOptimizer(int cap, const SizingOptions &sizingOptions = SizingOptions(),
+                   const PrefetchOptions &prefetchOptions = PrefetchOptions());
+    void accessFile(std::string_view filePath, const std::string &fileData = "", bool write = false);
+    // Starts a background thread that writes dirty files back to main memory (see WriteBack.h),
+    // appending them to journalFile when one is given. Call before sharing the cache between threads.
+    void enableWriteBack(const WriteBackOptions &options = WriteBackOptions(), const std::string &journalFile = "");
+    void flushDirty();  // Writes back every dirty file now
+    WriteBackStats writeBackStats() const;
     void printMetrics() const;
     void displayMainMemory() const;
 };
@@ -0,0 +1,187 @@
+#ifndef MISS_RATIO_CURVE_H
+#define MISS_RATIO_CURVE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Online estimate of the miss ratio curve: the hit ratio an LRU cache of each size would
+// have had on the accesses seen so far, sampled as in SHARDS (Waldspurger et al., FAST '15).
+//
+// Only files whose hashed ID falls below sampleRate are tracked, so a file is either always
+// or never sampled and the sampled accesses keep the reuse pattern of the whole trace. For
+// each sampled access the reuse distance (distinct sampled files accessed since the file's
+// previous access) goes into a histogram; divided by sampleRate it estimates the full
+// reuse distance, and an LRU cache of c entries hits exactly the accesses whose reuse
+// distance is below c. A few very hot files being in or out of the sample would skew the
+// curve, so the difference between the expected and actual number of sampled accesses is
+// credited to the smallest distance (SHARDS_adj). Reuse distances are counted with a Fenwick tree over access times
+// that holds a 1 at each sampled file's latest access. Histogram weights halve every
+// halfLife sampled accesses, so the curve follows a changing workload.
+class MissRatioCurve {
+public:
+    using Id = uint32_t;
+
+    struct Point {
+        size_t size;        // Cache size in entries
+        double hitRatio;    // Predicted for this size and up to the next point
+    };
+
+    explicit MissRatioCurve(double sampleRate = 0.01, double halfLife = 100000)
+        : threshold(static_cast<uint64_t>(std::clamp(sampleRate, 0.0, 1.0) * (1ull << 24))),
+          rate(std::clamp(sampleRate, 1.0 / (1 << 24), 1.0)), halfLife(halfLife), now(0),
+          sinceDecay(0), totalWeight(0), allWeight(0) {
+        tree.assign(1024, 0);
+    }
+
+    // Counts an access; costs one hash unless the file is sampled
+    void access(Id file) {
+        allWeight += 1;
+        if (!sampled(file)) {
+            return;
+        }
+        if (now == tree.size()) {
+            compact();
+        }
+        auto last = lastAccess.find(file);
+        if (last == lastAccess.end()) {  // First access: a miss at every size
+            lastAccess.emplace(file, now);
+        } else {
+            size_t distance = count(now) - count(last->second + 1);
+            if (distance >= histogram.size()) {
+                histogram.resize(distance + 1, 0);
+            }
+            histogram[distance] += 1;
+            add(last->second, -1);
+            last->second = now;
+        }
+        add(now++, 1);
+        totalWeight += 1;
+        if (++sinceDecay >= halfLife) {
+            decay();
+        }
+    }
+
+    // Predicted hit ratio of an LRU cache with `size` entries
+    double hitRatio(size_t size) const {
+        if (totalWeight == 0 || size == 0) {
+            return 0;
+        }
+        double hits = adjustment();
+        for (size_t distance = 0; distance < histogram.size() && distance < size * rate; ++distance) {
+            hits += histogram[distance];
+        }
+        return ratio(hits);
+    }
+
+    // The curve up to maxSize: every size at which the predicted hit ratio goes up, ascending
+    std::vector<Point> curve(size_t maxSize) const {
+        std::vector<Point> points;
+        double hits = adjustment();
+        for (size_t distance = 0; distance < histogram.size() && totalWeight > 0; ++distance) {
+            if (histogram[distance] == 0) {
+                continue;
+            }
+            size_t size = static_cast<size_t>(distance / rate) + 1;  // Smallest size with distance < size * rate
+            if (size > maxSize) {
+                break;
+            }
+            hits += histogram[distance];
+            if (!points.empty() && points.back().size == size) {
+                points.back().hitRatio = ratio(hits);
+            } else {
+                points.push_back({size, ratio(hits)});
+            }
+        }
+        return points;
+    }
+
+    // Sampled accesses the curve is based on, after decay
+    double samples() const {
+        return totalWeight;
+    }
+
+    size_t memoryBytes() const {
+        return tree.capacity() * sizeof(int32_t) + histogram.capacity() * sizeof(double) +
+               lastAccess.size() * (sizeof(std::pair<Id, uint32_t>) + 2 * sizeof(void *));
+    }
+
+private:
+    uint64_t threshold;  // Sampled: hash below this, out of 2^24
+    double rate;
+    double halfLife;
+    uint32_t now;        // Time of the next sampled access
+    double sinceDecay;
+    std::unordered_map<Id, uint32_t> lastAccess;  // Latest access time of each sampled file
+    std::vector<int32_t> tree;                     // Fenwick tree over access times
+    std::vector<double> histogram;                 // Weight of sampled accesses by reuse distance
+    double totalWeight;                            // Sampled accesses, including first ones
+    double allWeight;                              // All accesses
+
+    // Sampled accesses expected from the sampling rate, less those seen
+    double adjustment() const {
+        return allWeight * rate - totalWeight;
+    }
+
+    double ratio(double hits) const {
+        return std::clamp(hits / (allWeight * rate), 0.0, 1.0);
+    }
+
+    bool sampled(Id file) const {
+        uint64_t x = file + 0x9E3779B97F4A7C15ull;  // splitmix64 finalizer
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        x ^= x >> 31;
+        return (x & ((1ull << 24) - 1)) < threshold;
+    }
+
+    // Marked times below `end`
+    size_t count(size_t end) const {
+        size_t total = 0;
+        for (; end > 0; end &= end - 1) {
+            total += tree[end - 1];
+        }
+        return total;
+    }
+
+    void add(size_t time, int32_t delta) {
+        for (++time; time <= tree.size(); time += time & (0 - time)) {
+            tree[time - 1] += delta;
+        }
+    }
+
+    // Out of times: renumber the latest accesses 0..n-1 in order, doubling the tree if
+    // they fill more than half of it
+    void compact() {
+        std::vector<std::pair<uint32_t, Id>> latest;
+        latest.reserve(lastAccess.size());
+        for (const auto &entry : lastAccess) {
+            latest.emplace_back(entry.second, entry.first);
+        }
+        std::sort(latest.begin(), latest.end());
+        size_t size = tree.size();
+        while (latest.size() * 2 > size) {
+            size *= 2;
+        }
+        tree.assign(size, 0);
+        now = 0;
+        for (const auto &entry : latest) {
+            lastAccess[entry.second] = now;
+            add(now++, 1);
+        }
+    }
+
+    void decay() {
+        for (double &weight : histogram) {
+            weight /= 2;
+        }
+        totalWeight /= 2;
+        allWeight /= 2;
+        sinceDecay = 0;
+    }
+};
+
+#endif // MISS_RATIO_CURVE_H
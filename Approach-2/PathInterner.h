@@ -0,0 +1,95 @@
+#ifndef PATH_INTERNER_H
+#define PATH_INTERNER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Maps each distinct path to a dense 32-bit ID (0, 1, 2, ... in first-seen order), so the
+// cache structures can be keyed by ID: every path is stored once, and hashed once per
+// access at the API boundary instead of once per structure it is looked up in.
+//
+// Path bytes are copied into fixed blocks that never move, and the index is keyed by
+// string_views into them, so lookups take a string_view and never build a std::string.
+// IDs are never reused or released. Thread-safe; looking up a known path only takes a
+// shared lock.
+class PathInterner {
+public:
+    using Id = uint32_t;
+    static constexpr Id none = UINT32_MAX;
+
+    // ID of the path, assigning the next one if it is new
+    Id intern(std::string_view path) {
+        {
+            std::shared_lock<std::shared_mutex> guard(lock);
+            auto it = ids.find(path);
+            if (it != ids.end()) {
+                return it->second;
+            }
+        }
+        std::unique_lock<std::shared_mutex> guard(lock);
+        auto it = ids.find(path);  // Another thread may have added it in between
+        if (it != ids.end()) {
+            return it->second;
+        }
+        if (paths.size() >= none) {
+            throw std::length_error("PathInterner: out of 32-bit IDs");
+        }
+        std::string_view stored = store(path);
+        Id id = static_cast<Id>(paths.size());
+        paths.push_back(stored);
+        ids.emplace(stored, id);
+        return id;
+    }
+
+    // ID of a path interned before, or none
+    Id find(std::string_view path) const {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        auto it = ids.find(path);
+        return it == ids.end() ? none : it->second;
+    }
+
+    // The path behind an ID; stays valid as long as the interner
+    std::string_view path(Id id) const {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        return paths.at(id);
+    }
+
+    size_t size() const {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        return paths.size();
+    }
+
+private:
+    static constexpr size_t blockSize = 64 << 10;
+
+    std::vector<std::unique_ptr<char[]>> blocks;  // Path bytes, back-to-back
+    char *cursor = nullptr;                       // Free space left in blocks.back()
+    size_t remaining = 0;
+    std::vector<std::string_view> paths;          // Indexed by ID
+    std::unordered_map<std::string_view, Id> ids;
+    mutable std::shared_mutex lock;
+
+    std::string_view store(std::string_view path) {
+        if (!cursor || path.size() > remaining) {
+            size_t size = std::max(blockSize, path.size());
+            blocks.push_back(std::make_unique<char[]>(size));
+            cursor = blocks.back().get();
+            remaining = size;
+        }
+        std::memcpy(cursor, path.data(), path.size());
+        std::string_view stored(cursor, path.size());
+        cursor += path.size();
+        remaining -= path.size();
+        return stored;
+    }
+};
+
+#endif // PATH_INTERNER_H
@@ -0,0 +1,148 @@
+#include "ShardedCacheOptimizer.h"
+#include <functional>
+
+ShardedCacheOptimizer::ShardedCacheOptimizer(int cap, int shardCount) : totalCapacity(cap) {
+    // Every shard needs at least one slot, otherwise keys hashed to it could never be cached
+    if (shardCount < 1) shardCount = 1;
+    if (cap > 0 && shardCount > cap) shardCount = cap;
+
+    shards.reserve(shardCount);
+    for (int i = 0; i < shardCount; ++i) {
+        shards.push_back(std::make_unique<Shard>());
+        // Spread the remainder over the first shards so the slices add up to cap
+        shards.back()->capacity = cap / shardCount + (i < cap % shardCount ? 1 : 0);
+    }
+
+    // Initialize main memory with some dummy files (for demonstration)
+    for (int i = 1; i <= 5; ++i) {
+        std::string name = "file" + std::to_string(i);
+        shardFor(name).mainMemory[name] = "Content of " + name;
+    }
+}
+
+ShardedCacheOptimizer::Shard &ShardedCacheOptimizer::shardFor(const std::string &filePath) const {
+    // Mix the hash before reducing it; the shard's own unordered_map uses the same
+    // std::hash, so taking the raw low bits would leave its buckets correlated.
+    size_t h = std::hash<std::string>{}(filePath);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return *shards[h % shards.size()];
+}
+
+void ShardedCacheOptimizer::accessFile(const std::string &filePath, const std::string &fileData, bool write) {
+    Shard &shard = shardFor(filePath);
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    auto it = shard.cache.find(filePath);
+    if (it != shard.cache.end()) {  // Cache hit
+        shard.hits.fetch_add(1, std::memory_order_relaxed);
+        shard.touch(it->second);
+
+        if (write) {  // If write access, update fileData and set dirty bit
+            it->second.fileData = fileData;
+            it->second.dirty = true;
+        }
+        return;
+    }
+
+    // Cache miss
+    shard.misses.fetch_add(1, std::memory_order_relaxed);
+    if (shard.capacity <= 0) {
+        return;
+    }
+    if (shard.cache.size() >= static_cast<size_t>(shard.capacity)) {
+        shard.evict();
+    }
+
+    std::string data;
+    if (write) {
+        data = fileData;
+    } else {
+        auto mem = shard.mainMemory.find(filePath);
+        if (mem != shard.mainMemory.end()) {
+            data = mem->second;
+        }
+    }
+
+    std::list<std::string> &bucket = shard.freqLists[1];
+    bucket.push_front(filePath);
+    shard.cache.emplace(filePath, CacheItem{std::move(data), 1, write, bucket.begin()});
+    shard.minFrequency = 1;
+}
+
+void ShardedCacheOptimizer::Shard::touch(CacheItem &item) {
+    auto from = freqLists.find(item.frequency);
+    std::list<std::string> &to = freqLists[item.frequency + 1];
+
+    to.splice(to.begin(), from->second, item.lruPos);
+    if (from->second.empty()) {
+        freqLists.erase(from);
+        if (minFrequency == item.frequency) {
+            minFrequency = item.frequency + 1;
+        }
+    }
+    item.frequency++;
+}
+
+void ShardedCacheOptimizer::Shard::evict() {
+    // Same policy as CacheOptimizer::evict(): lowest frequency first, least recent among equals.
+    // Evictions are not logged here; per-eviction console output would serialize all threads.
+    auto bucket = freqLists.find(minFrequency);
+    std::string toEvict = std::move(bucket->second.back());
+    bucket->second.pop_back();
+    if (bucket->second.empty()) {
+        freqLists.erase(bucket);
+    }
+
+    auto it = cache.find(toEvict);
+    if (it->second.dirty) {
+        mainMemory[toEvict] = std::move(it->second.fileData);  // Write back to main memory
+        writebacks.fetch_add(1, std::memory_order_relaxed);
+    }
+    cache.erase(it);
+    evictions.fetch_add(1, std::memory_order_relaxed);
+}
+
+long long ShardedCacheOptimizer::sum(std::atomic<long long> Shard::*counter) const {
+    long long total = 0;
+    for (const auto &shard : shards) {
+        total += ((*shard).*counter).load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+long long ShardedCacheOptimizer::hits() const { return sum(&Shard::hits); }
+long long ShardedCacheOptimizer::misses() const { return sum(&Shard::misses); }
+long long ShardedCacheOptimizer::evictions() const { return sum(&Shard::evictions); }
+long long ShardedCacheOptimizer::writebacks() const { return sum(&Shard::writebacks); }
+
+size_t ShardedCacheOptimizer::size() const {
+    size_t total = 0;
+    for (const auto &shard : shards) {
+        std::lock_guard<std::mutex> guard(shard->lock);
+        total += shard->cache.size();
+    }
+    return total;
+}
+
+void ShardedCacheOptimizer::printMetrics() const {
+    long long h = hits(), m = misses();
+    double hitRate = (h + m) > 0 ? (double)h / (h + m) * 100 : 0.0;
+    double missRate = (h + m) > 0 ? (double)m / (h + m) * 100 : 0.0;
+
+    std::cout << "Cache Performance Metrics (" << shards.size() << " shards):" << std::endl;
+    std::cout << "Hits: " << h << " | Misses: " << m << std::endl;
+    std::cout << "Evictions: " << evictions() << " | Writebacks: " << writebacks() << std::endl;
+    std::cout << "Hit Rate: " << hitRate << "% | Miss Rate: " << missRate << "%" << std::endl;
+}
+
+void ShardedCacheOptimizer::displayMainMemory() const {
+    std::cout << "Main Memory Contents:" << std::endl;
+    for (const auto &shard : shards) {
+        std::lock_guard<std::mutex> guard(shard->lock);
+        for (const auto &entry : shard->mainMemory) {
+            std::cout << entry.first << ": " << entry.second << std::endl;
+        }
+    }
+}
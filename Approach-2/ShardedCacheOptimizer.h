@@ -0,0 +1,64 @@
+#ifndef SHARDED_CACHE_OPTIMIZER_H
+#define SHARDED_CACHE_OPTIMIZER_H
+
+#include <unordered_map>
+#include <list>
+#include <string>
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+// Thread-safe variant of CacheOptimizer. Keys are hashed onto independent shards,
+// each with its own lock, hybrid LRU-LFU state, capacity slice and slice of main
+// memory, so threads touching different shards never wait on each other.
+class ShardedCacheOptimizer {
+public:
+    ShardedCacheOptimizer(int cap, int shardCount = 16);
+
+    void accessFile(const std::string &filePath, const std::string &fileData = "", bool write = false);
+
+    // Counters are kept per shard and summed on read
+    long long hits() const;
+    long long misses() const;
+    long long evictions() const;
+    long long writebacks() const;
+    size_t size() const;
+    int capacity() const { return totalCapacity; }
+    int shardCount() const { return static_cast<int>(shards.size()); }
+
+    void printMetrics() const;
+    void displayMainMemory() const;
+
+private:
+    struct CacheItem {
+        std::string fileData;
+        int frequency;
+        bool dirty;
+        std::list<std::string>::iterator lruPos;  // Position inside freqLists[frequency]
+    };
+
+    // Aligned to a cache line so the locks and counters of neighbouring shards do not false-share
+    struct alignas(64) Shard {
+        mutable std::mutex lock;
+        int capacity = 0;
+        int minFrequency = 0;
+        std::unordered_map<std::string, CacheItem> cache;
+        std::unordered_map<int, std::list<std::string>> freqLists;  // LFU buckets, each ordered MRU first
+        std::unordered_map<std::string, std::string> mainMemory;     // Backing data for this shard's keys
+
+        std::atomic<long long> hits{0}, misses{0}, evictions{0}, writebacks{0};
+
+        void touch(CacheItem &item);
+        void evict();
+    };
+
+    int totalCapacity;
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    Shard &shardFor(const std::string &filePath) const;
+    long long sum(std::atomic<long long> Shard::*counter) const;
+};
+
+#endif // SHARDED_CACHE_OPTIMIZER_H
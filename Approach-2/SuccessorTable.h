@@ -0,0 +1,87 @@
+#ifndef SUCCESSOR_TABLE_H
+#define SUCCESSOR_TABLE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// First-order Markov model of which file is accessed right after which, for prefetching.
+//
+// Each file (by its dense PathInterner ID) has one fixed row of `ways` successor slots,
+// so the table costs a few dozen bytes per known file however long the trace runs. An
+// observation decays the row's weights by `decay` and adds 1 to the successor seen; a
+// successor that is not in the row replaces the lightest slot. A successor's probability
+// is its weight over the row's decayed observation count, so old habits fade and a
+// prediction needs both a recent majority and enough recent observations.
+class SuccessorTable {
+public:
+    using Id = uint32_t;
+    static constexpr Id none = UINT32_MAX;
+    static constexpr int ways = 4;
+
+    struct Prediction {
+        Id file;
+        double probability;
+    };
+
+    explicit SuccessorTable(double decay = 0.9) : decay(static_cast<float>(decay)) {}
+
+    void observe(Id from, Id to) {
+        if (from >= rows.size()) {
+            rows.resize(static_cast<size_t>(from) + 1);
+        }
+        Row &row = rows[from];
+        row.observations = row.observations * decay + 1;
+        Slot *lightest = &row.slots[0];
+        Slot *seen = nullptr;
+        for (Slot &slot : row.slots) {
+            slot.weight *= decay;
+            if (slot.file == to) seen = &slot;
+            if (slot.weight < lightest->weight) lightest = &slot;
+        }
+        if (!seen) {
+            seen = lightest;
+            *seen = Slot{to, 0};
+        }
+        seen->weight += 1;
+    }
+
+    // Successors of `from` with at least `confidence` probability, most likely first, once
+    // the row has seen `minObservations` (decayed) accesses. Replaces the contents of `out`.
+    void predict(Id from, double confidence, double minObservations, std::vector<Prediction> &out) const {
+        out.clear();
+        if (from >= rows.size() || rows[from].observations < minObservations) {
+            return;
+        }
+        const Row &row = rows[from];
+        for (const Slot &slot : row.slots) {
+            double probability = slot.weight / row.observations;
+            if (slot.file != none && probability >= confidence) {
+                out.push_back({slot.file, probability});
+            }
+        }
+        std::sort(out.begin(), out.end(),
+                  [](const Prediction &a, const Prediction &b) { return a.probability > b.probability; });
+    }
+
+    size_t memoryBytes() const {
+        return rows.capacity() * sizeof(Row);
+    }
+
+private:
+    struct Slot {
+        Id file = none;
+        float weight = 0;
+    };
+
+    struct Row {
+        float observations = 0;
+        Slot slots[ways];
+    };
+
+    float decay;
+    std::vector<Row> rows;  // Indexed by the predecessor's ID
+};
+
+#endif // SUCCESSOR_TABLE_H
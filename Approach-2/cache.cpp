@@ -1,142 +1,299 @@
 #include "CacheOptimizer.h"
-#include <unordered_set>
 
-CacheOptimizer::CacheOptimizer(int cap, int patternInterval, int adaptiveThreshold) 
+CacheOptimizer::CacheOptimizer(int cap, const SizingOptions &sizingOptions, const PrefetchOptions &prefetchOptions)
     : capacity(cap), hits(0), misses(0), evictions(0), writebacks(0),
-      patternAnalysisInterval(patternInterval), adaptiveCacheThreshold(adaptiveThreshold) {
+      sizing(sizingOptions), missRatioCurve(sizingOptions.sampleRate, sizingOptions.halfLife), accessesSinceSizing(0),
+      prefetch(prefetchOptions), successors(prefetchOptions.decay),
+      lastAccess(PathInterner::none), prefetchesIssued(0), prefetchesUsed(0), prefetchesWasted(0),
+      prefetchedBytes(0), wastedPrefetchBytes(0) {
     // Initialize main memory with some dummy files (for demonstration)
-    mainMemory["file1"] = "Content of file1";
-    mainMemory["file2"] = "Content of file2";
-    mainMemory["file3"] = "Content of file3";
-    mainMemory["file4"] = "Content of file4";
-    mainMemory["file5"] = "Content of file5";
-    
-    lastPatternAnalysisTime = std::chrono::steady_clock::now();
+    mainMemory[paths.intern("file1")] = "Content of file1";
+    mainMemory[paths.intern("file2")] = "Content of file2";
+    mainMemory[paths.intern("file3")] = "Content of file3";
+    mainMemory[paths.intern("file4")] = "Content of file4";
+    mainMemory[paths.intern("file5")] = "Content of file5";
 }
 
-void CacheOptimizer::accessFile(const std::string &filePath, const std::string &fileData, bool write) {
-    auto it = cache.find(filePath);
+void CacheOptimizer::accessFile(std::string_view filePath, const std::string &fileData, bool write) {
+    if (write && flusher) {
+        flusher->throttle();  // Blocks only at the hard dirty limit
+    }
+    FileId file = paths.intern(filePath);  // The only time the path is hashed
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = cache.find(file);
 
     // Track access history
-    accessCounts[filePath]++;
-
-    // Proactive caching: if file has a known next likely access, pre-cache it
-    if (accessPatterns.find(filePath) != accessPatterns.end()) {
-        for (const auto& nextFile : accessPatterns[filePath]) {
-            auto itNext = cache.find(nextFile);
-            if (itNext == cache.end()) {  // File not in cache, pre-cache it
-                std::string data = mainMemory[nextFile];
-                lruOrder.push_front(nextFile);
-                cache[nextFile] = {data, 1, false, lruOrder.begin()};
-                std::cout << "Pre-cached: " << nextFile << std::endl;
-            }
-        }
+    if (file >= accessCounts.size()) {
+        accessCounts.resize(file + 1);
+    }
+    accessCounts[file]++;
+    if (sizing.enabled) {
+        missRatioCurve.access(file);
     }
+    if (lastAccess != PathInterner::none && lastAccess != file) {
+        successors.observe(lastAccess, file);
+    }
+    lastAccess = file;
 
     if (it != cache.end()) {  // Cache hit
         hits++;
+        if (it->second.prefetched) {  // First access since it was prefetched
+            it->second.prefetched = false;
+            prefetchesUsed++;
+        }
         it->second.frequency++;  // Increase frequency count
-        lruOrder.erase(it->second.lruPos);  // Update LRU position
-        lruOrder.push_front(filePath);  // Move accessed file to the front
-        it->second.lruPos = lruOrder.begin();
+        lruOrder.splice(lruOrder.begin(), lruOrder, it->second.lruPos);  // Move accessed file to the front
         
         if (write) {  // If write access, update fileData and set dirty bit
             it->second.fileData = fileData;
-            it->second.dirty = true;
+            markDirty(file, it->second);
         }
     } else {  // Cache miss
         misses++;
 
-        // Fetch the file from main memory
-        std::string data = mainMemory[filePath];
-        
-        if (cache.size() >= capacity) {
-            evict();
-        }
-
-        // Add new file to cache
-        lruOrder.push_front(filePath);
-        cache[filePath] = {data, 1, false, lruOrder.begin()};  // Set dirty to false by default
+        // Fetch the file from main memory and add it to the cache
+        CacheItem &item = insert(file, mainMemory[file]);
         if (write) {
-            cache[filePath].fileData = fileData;
-            cache[filePath].dirty = true;  // Set dirty if it's a write access
-        }
-
-        // Update access patterns for proactive caching
-        for (auto& entry : cache) {
-            accessPatterns[entry.first].push_back(filePath);
+            item.fileData = fileData;
+            markDirty(file, item);  // Set dirty if it's a write access
         }
     }
 
-    // Periodically analyze access patterns
-    auto now = std::chrono::steady_clock::now();
-    if (std::chrono::duration_cast<std::chrono::seconds>(now - lastPatternAnalysisTime).count() >= patternAnalysisInterval) {
-        analyzeAccessPatterns();
-        lastPatternAnalysisTime = now;
-    }
+    // Proactive caching: bring in the files likely to be accessed next
+    prefetchSuccessors(file);
 
     // Adjust cache size based on access patterns
     adjustCacheSize();
+
+    if (write && flusher) {
+        flusher->dirtied();
+    }
 }
 
-void CacheOptimizer::evict() {
+void CacheOptimizer::markDirty(FileId file, CacheItem &item) {
+    if (item.dirty) {
+        dirtyFiles.resize(item.dirtyPos, item.fileData.size());
+    } else {
+        item.dirty = true;
+        item.dirtyPos = dirtyFiles.add(std::string(paths.path(file)), item.fileData.size());
+    }
+}
+
+CacheOptimizer::CacheItem &CacheOptimizer::insert(FileId file, std::string data, FileId keep) {
+    while (cache.size() >= static_cast<size_t>(std::max(capacity, 1)) && cache.size() > cache.count(keep)) {
+        evict(keep);
+    }
+    lruOrder.push_front(file);
+    CacheItem &item = cache[file];
+    item = {std::move(data), 1, false, lruOrder.begin()};  // Set dirty to false by default
+    return item;
+}
+
+// Prefetches go through insert() like misses, so they evict to make room instead of
+// growing the cache, and never evict the file that was just accessed
+void CacheOptimizer::prefetchSuccessors(FileId file) {
+    if (!prefetch.enabled || capacity < 2) {
+        return;
+    }
+    successors.predict(file, prefetch.confidence, prefetch.minObservations, predictions);
+    int issued = 0;
+    for (const SuccessorTable::Prediction &prediction : predictions) {
+        if (issued == prefetch.maxPrefetches) {
+            break;
+        }
+        if (cache.count(prediction.file)) {
+            continue;
+        }
+        auto mem = mainMemory.find(prediction.file);
+        CacheItem &item = insert(prediction.file, mem != mainMemory.end() ? mem->second : std::string(), file);
+        item.prefetched = true;
+        prefetchesIssued++;
+        prefetchedBytes += item.fileData.size();
+        issued++;
+        std::cout << "Prefetched: " << paths.path(prediction.file) << " (p = " << prediction.probability << ")" << std::endl;
+    }
+}
+
+void CacheOptimizer::evict(FileId keep) {
     // Find the least frequently used file with the least recency (i.e., at the end of lruOrder)
     auto lru_it = lruOrder.rbegin();
-    std::string toEvict = *lru_it;
+    if (*lru_it == keep) {
+        ++lru_it;
+    }
+    FileId toEvict = *lru_it;
+    auto victim = cache.find(toEvict);
 
     // Identify the file with the lowest frequency among the least recent files
-    for (const auto &entry : cache) {
-        if (entry.second.frequency < cache[toEvict].frequency ||
-            (entry.second.frequency == cache[toEvict].frequency && entry.second.lruPos == lruOrder.end())) {
-            toEvict = entry.first;
+    for (auto entry = cache.begin(); entry != cache.end(); ++entry) {
+        if (entry->first == keep) {
+            continue;
         }
+        if (entry->second.frequency < victim->second.frequency ||
+            (entry->second.frequency == victim->second.frequency && entry->second.lruPos == lruOrder.end())) {
+            victim = entry;
+        }
+    }
+    toEvict = victim->first;
+    CacheItem &item = victim->second;
+    if (item.prefetched) {
+        prefetchesWasted++;
+        wastedPrefetchBytes += item.fileData.size();
     }
 
     // Check if the file is dirty, write back to main memory if needed
-    if (cache[toEvict].dirty) {
-        mainMemory[toEvict] = cache[toEvict].fileData;  // Write back to main memory
+    if (item.dirty) {
+        if (journal) {
+            evictedDirty.push_back({std::string(paths.path(toEvict)), item.fileData, item.dirtyPos->since});
+        }
+        dirtyFiles.remove(item.dirtyPos);
+        mainMemory[toEvict] = item.fileData;  // Write back to main memory
         writebacks++;
-        std::cout << "Evicted and wrote back: " << toEvict << " (Hybrid LRU-LFU, Dirty)" << std::endl;
+        std::cout << "Evicted and wrote back: " << paths.path(toEvict) << " (Hybrid LRU-LFU, Dirty)" << std::endl;
     } else {
-        std::cout << "Evicted: " << toEvict << " (Hybrid LRU-LFU)" << std::endl;
+        std::cout << "Evicted: " << paths.path(toEvict) << " (Hybrid LRU-LFU)" << std::endl;
     }
 
     // Remove the file from cache and LRU list
-    lruOrder.erase(cache[toEvict].lruPos);
-    cache.erase(toEvict);
+    lruOrder.erase(item.lruPos);
+    cache.erase(victim);
     evictions++;
 }
 
-void CacheOptimizer::analyzeAccessPatterns() {
-    std::cout << "Analyzing access patterns..." << std::endl;
+void CacheOptimizer::adjustCacheSize() {
+    if (!sizing.enabled || ++accessesSinceSizing < sizing.interval) {
+        return;
+    }
+    accessesSinceSizing = 0;
+    if (missRatioCurve.samples() < sizing.minSamples) {
+        return;
+    }
 
-    for (auto& entry : accessPatterns) {
-        const std::string& currentFile = entry.first;
-        std::vector<std::string>& nextFiles = entry.second;
+    int change = chooseCapacity() - capacity;
+    if (change == 0 || std::abs(change) <= sizing.hysteresis * capacity) {
+        return;
+    }
+    int step = std::max(1, static_cast<int>(sizing.maxStep * capacity));
+    capacity += std::max(-step, std::min(change, step));
+    std::cout << (change > 0 ? "Increasing" : "Decreasing") << " cache size to: " << capacity
+              << " (predicted hit ratio " << missRatioCurve.hitRatio(capacity) * 100 << "%)" << std::endl;
+    while (cache.size() > static_cast<size_t>(capacity)) {
+        evict(lastAccess);
+    }
+}
 
-        // Use a set to eliminate duplicates and track relationships
-        std::unordered_set<std::string> uniqueNextFiles(nextFiles.begin(), nextFiles.end());
-        nextFiles.assign(uniqueNextFiles.begin(), uniqueNextFiles.end());
+int CacheOptimizer::chooseCapacity() const {
+    const int minCapacity = std::max(sizing.minCapacity, 1);
+    const int maxCapacity = std::max(sizing.maxCapacity, minCapacity);
+    std::vector<MissRatioCurve::Point> curve = missRatioCurve.curve(maxCapacity);
 
-        // Limit the size of nextFiles to prevent memory issues
-        const size_t maxPatternSize = 5;
-        if (nextFiles.size() > maxPatternSize) {
-            nextFiles.resize(maxPatternSize);
+    // The curve is flat between its points, so only minCapacity and the points can be best
+    double hitRatio = 0;
+    size_t next = 0;
+    while (next < curve.size() && curve[next].size <= static_cast<size_t>(minCapacity)) {
+        hitRatio = curve[next++].hitRatio;
+    }
+    int best = minCapacity;
+    double bestUtility = hitRatio - sizing.minMarginalGain * minCapacity;
+    int reachesTarget = hitRatio >= sizing.targetHitRatio ? minCapacity : -1;
+    for (; next < curve.size(); ++next) {
+        int size = static_cast<int>(curve[next].size);
+        double utility = curve[next].hitRatio - sizing.minMarginalGain * size;
+        if (utility > bestUtility) {
+            best = size;
+            bestUtility = utility;
+        }
+        if (reachesTarget < 0 && curve[next].hitRatio >= sizing.targetHitRatio) {
+            reachesTarget = size;
         }
     }
+    return reachesTarget >= 0 ? std::min(reachesTarget, best) : best;
 }
 
-void CacheOptimizer::adjustCacheSize() {
-    if (misses > adaptiveCacheThreshold) {
-        capacity++;  // Increase cache size dynamically if access frequency increases
-        std::cout << "Increasing cache size to: " << capacity << std::endl;
-    } else if (hits > adaptiveCacheThreshold && capacity > 2) {
-        capacity--;  // Decrease cache size if access rate drops and cache size is large
-        std::cout << "Decreasing cache size to: " << capacity << std::endl;
+void CacheOptimizer::enableWriteBack(const WriteBackOptions &options, const std::string &journalFile) {
+    if (flusher) {
+        return;
+    }
+    if (!journalFile.empty()) {
+        journal = std::make_unique<WriteBackJournal>(journalFile);
+    }
+    flusher = std::make_unique<WriteBackFlusher>(
+        options, dirtyFiles,
+        [this](DirtyTracker::Clock::time_point cutoff, size_t excessBytes, bool all) {
+            return collectDirty(cutoff, excessBytes, all);
+        },
+        [this](const std::vector<DirtyRecord> &batch) {
+            if (journal) {
+                journal->append(batch);
+            }
+        },
+        [this](std::vector<DirtyRecord> batch) { requeueDirty(std::move(batch)); });
+}
+
+// Runs on the flusher thread; main memory is updated under the cache lock, the journal outside it
+std::vector<DirtyRecord> CacheOptimizer::collectDirty(DirtyTracker::Clock::time_point cutoff, size_t excessBytes, bool all) {
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<DirtyRecord> records = std::move(evictedDirty);
+    evictedDirty.clear();
+    for (DirtyTracker::Entry &entry : dirtyFiles.takeDue(cutoff, excessBytes, all)) {
+        FileId file = paths.find(entry.path);
+        CacheItem &item = cache.find(file)->second;
+        item.dirty = false;
+        mainMemory[file] = item.fileData;
+        writebacks++;
+        records.push_back({std::move(entry.path), item.fileData, entry.since, entry.bytes});
     }
+    return records;
+}
+
+// Runs on the flusher thread when a batch could not be journaled: files still cached are
+// dirty again from their original time, evicted ones only wait for the journal again
+void CacheOptimizer::requeueDirty(std::vector<DirtyRecord> batch) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (DirtyRecord &record : batch) {
+        auto it = cache.find(paths.find(record.path));
+        if (it == cache.end()) {
+            // A version evicted after this batch was collected is newer and supersedes it
+            bool superseded = std::any_of(evictedDirty.begin(), evictedDirty.end(),
+                                          [&](const DirtyRecord &pending) { return pending.path == record.path; });
+            if (!superseded) {
+                record.trackedBytes = 0;  // Released by the flusher when this batch failed
+                evictedDirty.push_back(std::move(record));
+            }
+            continue;
+        }
+        CacheItem &item = it->second;
+        auto since = record.since;
+        if (item.dirty) {
+            since = std::min(since, item.dirtyPos->since);
+            dirtyFiles.remove(item.dirtyPos);
+        }
+        item.dirty = true;
+        item.dirtyPos = dirtyFiles.restore(record.path, item.fileData.size(), since);
+    }
+}
+
+void CacheOptimizer::flushDirty() {
+    if (flusher) {
+        flusher->flushAll();
+        return;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    for (const DirtyTracker::Entry &entry : dirtyFiles.takeDue(DirtyTracker::Clock::now(), 0, true)) {
+        FileId file = paths.find(entry.path);
+        CacheItem &item = cache.find(file)->second;
+        item.dirty = false;
+        mainMemory[file] = item.fileData;
+        writebacks++;
+        dirtyFiles.written(entry.bytes);
+    }
+}
+
+WriteBackStats CacheOptimizer::writeBackStats() const {
+    return flusher ? flusher->statistics() : WriteBackStats();
 }
 
 void CacheOptimizer::printMetrics() const {
+    std::lock_guard<std::mutex> guard(lock);
     double hitRate = (double)hits / (hits + misses) * 100;
     double missRate = (double)misses / (hits + misses) * 100;
 
@@ -144,13 +301,27 @@ void CacheOptimizer::printMetrics() const {
     std::cout << "Hits: " << hits << " | Misses: " << misses << std::endl;
     std::cout << "Evictions: " << evictions << " | Writebacks: " << writebacks << std::endl;
     std::cout << "Hit Rate: " << hitRate << "% | Miss Rate: " << missRate << "%" << std::endl;
+    if (prefetch.enabled) {
+        // Accuracy: prefetched files that were then accessed. Coverage: the share of
+        // would-be misses that prefetching turned into hits.
+        double accuracy = prefetchesIssued ? (double)prefetchesUsed / prefetchesIssued * 100 : 0.0;
+        double coverage = prefetchesUsed + misses ? (double)prefetchesUsed / (prefetchesUsed + misses) * 100 : 0.0;
+        std::cout << "Prefetches: " << prefetchesIssued << " (" << prefetchedBytes << " bytes) | Used: " << prefetchesUsed
+                  << " | Evicted unused: " << prefetchesWasted << " (" << wastedPrefetchBytes << " bytes)" << std::endl;
+        std::cout << "Prefetch Accuracy: " << accuracy << "% | Coverage: " << coverage << "%"
+                  << " | Successor table: " << successors.memoryBytes() << " bytes" << std::endl;
+    }
+    if (flusher) {
+        flusher->statistics().print();
+    }
 }
 
 // New: Display the contents of main memory
 void CacheOptimizer::displayMainMemory() const {
+    std::lock_guard<std::mutex> guard(lock);
     std::cout << "Main Memory Contents:" << std::endl;
     for (const auto &entry : mainMemory) {
-        std::cout << entry.first << ": " << entry.second << std::endl;
+        std::cout << paths.path(entry.first) << ": " << entry.second << std::endl;
     }
 }
 // #include <iostream>
@@ -170,8 +341,8 @@ void CacheOptimizer::displayMainMemory() const {
 // }
 
 // int main() {
-//     // Initialize a CacheOptimizer with small capacity and short analysis intervals
-//     CacheOptimizer cache(3, 1, 5);
+//     // Initialize a CacheOptimizer with small capacity
+//     CacheOptimizer cache(3);
 
 //     // File access sequence with repeated patterns for testing proactive caching
 //     std::vector<std::string> fileSequence = {
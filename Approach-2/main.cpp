@@ -1,6 +1,8 @@
 #include <iostream>
 #include "CacheOptimizer.h" 
+#include "ShardedCacheOptimizer.h"
 #include "test.h" 
+#include <thread>
 
 // Helper function to simulate file accesses in a sequence
 void simulateFileAccess(CacheOptimizer& cache, const std::vector<std::string>& files) {
@@ -24,28 +26,33 @@ void evictionTest() {
     TestFramework::assertEqual("file1", "file1", "Eviction Test");
 }
 
+// Sizing that reacts within a few accesses, for tiny test traces
+SizingOptions quickSizing() {
+    SizingOptions sizing;
+    sizing.sampleRate = 1;  // Every file feeds the miss ratio curve
+    sizing.interval = 5;
+    sizing.minSamples = 10;
+    sizing.halfLife = 20;
+    return sizing;
+}
+
 // Test cache resizing based on access patterns
 void cacheResizingTest() {
-    CacheOptimizer cache(3);  // Initial cache size is 3
+    CacheOptimizer cache(3, quickSizing());  // Initial cache size is 3
     int initialCapacity = 3;
 
-    // Simulate high access rate (misses) to increase cache size
-    cache.accessFile("file1");
-    cache.accessFile("file2");
-    cache.accessFile("file3");
-    cache.accessFile("file4");
-    cache.accessFile("file5");
-
-    // Cache size should increase due to frequent misses
-    TestFramework::assertTrue(cache.capacity > initialCapacity, "Cache Resizing Test");
-    
-    // Simulate access pattern with hits and check for cache resizing
-    cache.accessFile("file1");
-    cache.accessFile("file3");
-    cache.accessFile("file4");
+    // A loop over five files only hits in a cache that holds all five
+    for (int round = 0; round < 4; ++round) {
+        simulateFileAccess(cache, {"file1", "file2", "file3", "file4", "file5"});
+    }
+    TestFramework::assertTrue(cache.capacity == 5, "Cache Resizing Test");
 
-    // Cache should decrease if hit rate increases
-    TestFramework::assertTrue(cache.capacity < (initialCapacity + 2), "Cache Resizing on Hits Test");
+    // Once only two files are in use, the other entries stop paying off
+    for (int round = 0; round < 50; ++round) {
+        simulateFileAccess(cache, {"file1", "file2"});
+    }
+    TestFramework::assertTrue(cache.capacity < initialCapacity && cache.cache.size() <= static_cast<size_t>(cache.capacity),
+                              "Cache Resizing on Hits Test");
 }
 
 // Test access pattern analysis and proactive caching
@@ -62,17 +69,18 @@ void accessPatternAnalysisTest() {
 
 // Test the behavior when access patterns trigger proactive caching
 void proactiveCachingTest() {
-    CacheOptimizer cache(3);
-    cache.accessFile("file1");
-    cache.accessFile("file2");
-    cache.accessFile("file3");
-
-    // Now simulate access to a file that should trigger proactive caching
-    cache.accessFile("file1");
+    SizingOptions fixedSize;
+    fixedSize.enabled = false;  // The capacity stays at 3
+    CacheOptimizer cache(3, fixedSize);
+
+    // Loop over more files than fit: plain LRU-LFU misses every time, but each
+    // file's successor is predictable once the loop has been seen twice
+    for (int round = 0; round < 5; ++round) {
+        simulateFileAccess(cache, {"file1", "file2", "file3", "file4", "file5"});
+    }
 
-    // Check if the next likely file is pre-cached
-    // For now, we assume the proactive caching is working.
-    TestFramework::assertTrue(true, "Proactive Caching Test");
+    TestFramework::assertTrue(cache.prefetchesUsed > 0 && cache.hits > 0, "Proactive Caching Test");
+    TestFramework::assertTrue(cache.cache.size() <= 3, "Prefetch Respects Capacity Test");
 }
 
 // Test for Cache hit and miss count validation
@@ -107,16 +115,90 @@ void evictionAndWritebackTest() {
     TestFramework::assertTrue(true, "Eviction and Writeback Test");
 }
 
-// Test adaptive cache threshold behavior (increased cache size)
+// Test that adaptive sizing grows the cache but stays within its memory budget
 void adaptiveCacheThresholdTest() {
+    SizingOptions sizing = quickSizing();
+    sizing.maxCapacity = 4;
+    CacheOptimizer cache(3, sizing);
+
+    // Sweeping back and forth over six files, every size up to six adds hits
+    for (int round = 0; round < 10; ++round) {
+        simulateFileAccess(cache, {"file1", "file2", "file3", "file4", "file5", "file6", "file5", "file4", "file3", "file2"});
+    }
+
+    // The curve asks for more than the budget of four entries allows
+    TestFramework::assertTrue(cache.capacity == 4, "Adaptive Cache Threshold Test");
+}
+
+// Test the sharded cache under concurrent access from several threads
+void shardedConcurrencyTest() {
+    ShardedCacheOptimizer cache(8, 4);
+    const int threads = 4, accessesPerThread = 1000;
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&cache, t] {
+            for (int i = 0; i < accessesPerThread; ++i) {
+                std::string file = "file" + std::to_string((i * 7 + t) % 20);
+                cache.accessFile(file, "Written by thread " + std::to_string(t), i % 10 == 0);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // Every access is counted exactly once and no shard exceeds its capacity slice
+    TestFramework::assertTrue(cache.hits() + cache.misses() == threads * accessesPerThread, "Sharded Access Count Test");
+    TestFramework::assertTrue(cache.size() <= 8, "Sharded Capacity Test");
+    TestFramework::assertTrue(cache.evictions() == cache.misses() - static_cast<long long>(cache.size()), "Sharded Eviction Count Test");
+}
+
+// Test the background write-back flusher
+void writeBackFlusherTest() {
     CacheOptimizer cache(3);
-    cache.accessFile("file1");
+    WriteBackOptions options;
+    options.maxAge = std::chrono::milliseconds(0);
+    options.interval = std::chrono::milliseconds(5);
+    cache.enableWriteBack(options);
+
+    cache.accessFile("file1", "Updated file1 content", true);
+    cache.accessFile("file2", "Updated file2 content", true);
+    cache.flushDirty();
+
+    // Both writes reach main memory without being evicted, and the files stay cached clean
+    TestFramework::assertEqual("Updated file1 content", cache.mainMemory.at(cache.paths.find("file1")).c_str(), "Write-back Flush Test");
+    TestFramework::assertEqual("Updated file2 content", cache.mainMemory.at(cache.paths.find("file2")).c_str(), "Write-back Flush Second File Test");
+    TestFramework::assertTrue(!cache.cache.at(cache.paths.find("file1")).dirty && !cache.cache.at(cache.paths.find("file2")).dirty, "Write-back Clean After Flush Test");
+    TestFramework::assertEqual(2, static_cast<int>(cache.writeBackStats().records), "Write-back Record Count Test");
+}
+
+// Test that a failed batch whose file was evicted meanwhile is retried without being
+// counted twice: the flusher has already released its bytes from the tracker
+void writeBackFailedEvictionTest() {
+    CacheOptimizer cache(2);
+    WriteBackOptions options;
+    options.interval = std::chrono::hours(1);  // Flushes only when the test asks
+    options.hardLimitBytes = 1 << 10;
+    cache.enableWriteBack(options, "/dev/full");  // Every journal write fails
+    cache.accessFile("file1", "Updated file1 content", true);
+
+    // The flusher's failure path, with file1 evicted between taking the batch and handing it back
+    std::vector<DirtyRecord> batch = cache.collectDirty(DirtyTracker::Clock::now(), 0, true);
+    size_t tracked = batch.empty() ? 0 : batch[0].trackedBytes;
     cache.accessFile("file2");
     cache.accessFile("file3");
-    cache.accessFile("file4");
-
-    // Cache should have increased its size based on access patterns
-    TestFramework::assertTrue(cache.capacity > 3, "Adaptive Cache Threshold Test");
+    cache.requeueDirty(std::move(batch));
+    cache.dirtyFiles.written(tracked);
+
+    cache.flushDirty();  // Fails again, on the record now waiting in the evicted list
+    size_t unflushed = cache.dirtyFiles.unflushed();
+    TestFramework::assertTrue(unflushed < options.hardLimitBytes, "Write-back Failed Eviction Unflushed Test");
+    if (unflushed < options.hardLimitBytes) {
+        cache.flusher->throttle();  // Returns at once below the hard limit
+    }
+    TestFramework::assertTrue(cache.writeBackStats().failures == 1 && cache.evictedDirty.size() == 1,
+                              "Write-back Failed Eviction Retry Test");
 }
 
 int main() {
@@ -127,6 +209,9 @@ int main() {
     hitMissCountTest();
     evictionAndWritebackTest();
     adaptiveCacheThresholdTest();
+    shardedConcurrencyTest();
+    writeBackFlusherTest();
+    writeBackFailedEvictionTest();
 
     // Final report of tests
     TestFramework::report();
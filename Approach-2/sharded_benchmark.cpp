@@ -0,0 +1,101 @@
+// Multi-threaded throughput of ShardedCacheOptimizer, sweeping the thread count.
+// A single shard is the same code behind one global lock, which is the baseline.
+// Build: g++ -O2 -std=c++17 -pthread sharded_benchmark.cpp ShardedCacheOptimizer.cpp -o sharded_benchmark
+#include "ShardedCacheOptimizer.h"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+
+struct Access {
+    int key;
+    bool write;
+};
+
+// Read-heavy mix: 95% reads, keys skewed towards a hot set that fits in the cache
+std::vector<Access> makeTrace(size_t operations, int universe, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::geometric_distribution<int> hot(8.0 / universe);
+    std::uniform_int_distribution<int> any(0, universe - 1);
+    std::bernoulli_distribution coldCoin(0.1), writeCoin(0.05);
+
+    std::vector<Access> trace(operations);
+    for (auto &a : trace) {
+        int key = coldCoin(gen) ? any(gen) : hot(gen);
+        a.key = key < universe ? key : any(gen);
+        a.write = writeCoin(gen);
+    }
+    return trace;
+}
+
+double run(int shardCount, int threadCount, int capacity, const std::vector<std::string> &keys,
+           const std::vector<std::vector<Access>> &traces) {
+    ShardedCacheOptimizer cache(capacity, shardCount);
+    for (int i = 0; i < capacity; ++i) {
+        cache.accessFile(keys[i]);
+    }
+
+    const std::string payload = "benchmark payload";
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threadCount; ++t) {
+        workers.emplace_back([&, t] {
+            for (const Access &a : traces[t]) {
+                cache.accessFile(keys[a.key], payload, a.write);
+            }
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t operations = 0;
+    for (int t = 0; t < threadCount; ++t) {
+        operations += traces[t].size();
+    }
+    return operations / seconds;
+}
+
+int main(int argc, char *argv[]) {
+    const size_t opsPerThread = argc > 1 ? std::stoul(argv[1]) : 500000;
+    const int capacity = argc > 2 ? std::stoi(argv[2]) : 100000;
+    const int shardCount = argc > 3 ? std::stoi(argv[3]) : 64;
+    const std::vector<int> threadCounts = {1, 2, 4, 8, 16, 32};
+    const int universe = capacity * 2;
+
+    std::vector<std::string> keys;
+    keys.reserve(universe);
+    for (int i = 0; i < universe; ++i) {
+        keys.push_back("file" + std::to_string(i));
+    }
+
+    std::vector<std::vector<Access>> traces;
+    for (int t = 0; t < threadCounts.back(); ++t) {
+        traces.push_back(makeTrace(opsPerThread, universe, 1000 + t));
+    }
+
+    std::cout << "Hardware threads: " << std::thread::hardware_concurrency()
+              << " | Capacity: " << capacity << " | Ops/thread: " << opsPerThread << std::endl;
+    std::cout << std::left << std::setw(10) << "Threads"
+              << std::right << std::setw(18) << "1 shard ops/s"
+              << std::setw(18) << (std::to_string(shardCount) + " shards ops/s")
+              << std::setw(10) << "Speedup" << std::endl;
+
+    double base = 0.0;
+    for (int threads : threadCounts) {
+        double global = run(1, threads, capacity, keys, traces);
+        double sharded = run(shardCount, threads, capacity, keys, traces);
+        if (threads == 1) base = sharded;
+
+        std::cout << std::left << std::setw(10) << threads
+                  << std::right << std::fixed << std::setprecision(0)
+                  << std::setw(18) << global
+                  << std::setw(18) << sharded
+                  << std::setw(9) << std::setprecision(2) << sharded / base << "x" << std::endl;
+    }
+
+    return 0;
+}
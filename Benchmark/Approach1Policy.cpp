@@ -0,0 +1,35 @@
+// The implementation is compiled into its own namespace so it can be linked next to
+// the other CacheOptimizer classes. Everything it includes from the standard library
+// is included first, which turns its own #includes into no-ops inside the namespace.
+#include <bits/stdc++.h>
+// POSIX headers used by the wrapped file (through WriteBack.h) must be included outside the namespace too
+#include <fcntl.h>
+#include <unistd.h>
+#include "CachePolicy.h"
+
+namespace approach1 {
+#include "../Approach -1/Cacheoptimizer.cpp"
+}
+
+namespace {
+
+class Approach1Policy : public CachePolicy {
+public:
+    explicit Approach1Policy(size_t capacity) : cache(static_cast<int>(capacity)) {}
+
+    bool access(const TraceRecord& record) override {
+        int hitsBefore = cache.hitCount();
+        cache.accessFile(record.path, payload, record.write);
+        return cache.hitCount() != hitsBefore;
+    }
+
+private:
+    approach1::CacheOptimizer cache;
+    const std::string payload = "replayed write";
+};
+
+} // namespace
+
+std::unique_ptr<CachePolicy> makeApproach1Policy(size_t capacity) {
+    return std::make_unique<Approach1Policy>(capacity);
+}
@@ -0,0 +1,41 @@
+// See Approach1Policy.cpp for why the implementation is included inside a namespace
+#include <bits/stdc++.h>
+// POSIX headers used by the wrapped file (through WriteBack.h) must be included outside the namespace too
+#include <fcntl.h>
+#include <unistd.h>
+#include "CachePolicy.h"
+
+namespace approach2 {
+#include "../Approach-2/cache.cpp"
+}
+
+namespace {
+
+class Approach2Policy : public CachePolicy {
+public:
+    // Adaptive sizing is disabled so the cache stays at the size being measured
+    explicit Approach2Policy(size_t capacity)
+        : cache(static_cast<int>(capacity), fixedSize()) {}
+
+    bool access(const TraceRecord& record) override {
+        int hitsBefore = cache.hits;
+        cache.accessFile(record.path, payload, record.write);
+        return cache.hits != hitsBefore;
+    }
+
+private:
+    static approach2::SizingOptions fixedSize() {
+        approach2::SizingOptions options;
+        options.enabled = false;
+        return options;
+    }
+
+    approach2::CacheOptimizer cache;
+    const std::string payload = "replayed write";
+};
+
+} // namespace
+
+std::unique_ptr<CachePolicy> makeApproach2Policy(size_t capacity) {
+    return std::make_unique<Approach2Policy>(capacity);
+}
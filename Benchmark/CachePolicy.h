@@ -0,0 +1,29 @@
+#ifndef CACHE_POLICY_H
+#define CACHE_POLICY_H
+
+#include "Trace.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Uniform interface the trace replay drives every cache implementation through.
+// Each adapter lives in its own translation unit because the implementations
+// reuse class names (CacheOptimizer, Cache, ...) and cannot share one.
+class CachePolicy {
+public:
+    virtual ~CachePolicy() {}
+
+    // Performs the operation and returns true if it was served from the cache
+    virtual bool access(const TraceRecord& record) = 0;
+};
+
+// Adapter factories. Capacity is in entries, except for the byte-budgeted LFU Cache
+// from FileSystemCacheOptimizer.cpp ("lfu", "tinylfu", "slablfu") where it is in bytes.
+std::unique_ptr<CachePolicy> makeApproach1Policy(size_t capacity);
+std::unique_ptr<CachePolicy> makeApproach2Policy(size_t capacity);
+std::unique_ptr<CachePolicy> makeShardedPolicy(size_t capacity);
+std::unique_ptr<CachePolicy> makeClockPolicy(size_t capacity);
+std::unique_ptr<CachePolicy> makeLfuPolicy(size_t capacityBytes, size_t expectedEntries, bool admissionFilter,
+                                           bool slabAllocator = false);
+
+#endif // CACHE_POLICY_H
@@ -0,0 +1,30 @@
+// See Approach1Policy.cpp for why the implementation is included inside a namespace
+#include <bits/stdc++.h>
+#include "CachePolicy.h"
+
+namespace clockcache {
+#include "../ClockCache.cpp"
+}
+
+namespace {
+
+// ClockCache has no write path; writes are replayed as accesses
+class ClockPolicy : public CachePolicy {
+public:
+    explicit ClockPolicy(size_t capacity) : cache(static_cast<int>(capacity), false) {}
+
+    bool access(const TraceRecord& record) override {
+        bool hit = false;
+        cache.accessFile(record.path, &hit);
+        return hit;
+    }
+
+private:
+    clockcache::ClockCache cache;
+};
+
+} // namespace
+
+std::unique_ptr<CachePolicy> makeClockPolicy(size_t capacity) {
+    return std::make_unique<ClockPolicy>(capacity);
+}
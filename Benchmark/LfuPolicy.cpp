@@ -0,0 +1,55 @@
+// See Approach1Policy.cpp for why the implementation is included inside a namespace
+#include <bits/stdc++.h>
+// POSIX headers used by the wrapped file must be included outside the namespace too
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "CachePolicy.h"
+
+namespace lfu {
+#include "../FileSystemCacheOptimizer.cpp"
+}
+
+namespace {
+
+// Drives the byte-budgeted Cache the same way FileSystemCacheOptimizer does:
+// reads go through get() or put() on a miss, writes only update cached files.
+// File contents are materialized at the traced size so the byte budget is real.
+class LfuPolicy : public CachePolicy {
+public:
+    LfuPolicy(size_t capacityBytes, size_t expectedEntries, bool admissionFilter, bool slabAllocator)
+        : cache(capacityBytes) {
+        if (admissionFilter) {
+            cache.enableAdmissionFilter(expectedEntries);
+        }
+        if (slabAllocator) {
+            cache.enableSlabAllocator();
+        }
+    }
+
+    bool access(const TraceRecord& record) override {
+        if (cache.isCached(record.path)) {
+            if (record.write) {
+                cache.put(lfu::File(record.path, std::string(record.size, 'w')));
+            } else {
+                cache.get(record.path);
+            }
+            return true;
+        }
+        if (!record.write) {
+            cache.put(lfu::File(record.path, std::string(record.size, 'r')));
+        }
+        return false;
+    }
+
+private:
+    lfu::Cache cache;
+};
+
+} // namespace
+
+std::unique_ptr<CachePolicy> makeLfuPolicy(size_t capacityBytes, size_t expectedEntries, bool admissionFilter,
+                                           bool slabAllocator) {
+    return std::make_unique<LfuPolicy>(capacityBytes, expectedEntries, admissionFilter, slabAllocator);
+}
@@ -0,0 +1,25 @@
+#include "CachePolicy.h"
+#include "../Approach-2/ShardedCacheOptimizer.h"
+
+namespace {
+
+class ShardedPolicy : public CachePolicy {
+public:
+    explicit ShardedPolicy(size_t capacity) : cache(static_cast<int>(capacity)) {}
+
+    bool access(const TraceRecord& record) override {
+        long long hitsBefore = cache.hits();
+        cache.accessFile(record.path, payload, record.write);
+        return cache.hits() != hitsBefore;
+    }
+
+private:
+    ShardedCacheOptimizer cache;
+    const std::string payload = "replayed write";
+};
+
+} // namespace
+
+std::unique_ptr<CachePolicy> makeShardedPolicy(size_t capacity) {
+    return std::make_unique<ShardedPolicy>(capacity);
+}
@@ -0,0 +1,134 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// One file operation from a recorded or synthetic workload
+struct TraceRecord {
+    uint64_t timestamp;  // Microseconds, only carried through (replay is not paced)
+    std::string path;
+    bool write;
+    uint64_t size;       // Bytes read or written
+};
+
+// Trace files come in two formats:
+//  - CSV, one "timestamp,path,op,size" line per record, op being R/W (or read/write).
+//    A header line and lines starting with '#' are skipped.
+//  - Binary, the 8 byte magic "CTRACE1\n" followed by records of
+//    u64 timestamp, u32 path length, path bytes, u8 op (0 read, 1 write), u64 size,
+//    all little-endian. This is the faster format for traces with millions of records.
+namespace trace {
+
+const char binaryMagic[8] = {'C', 'T', 'R', 'A', 'C', 'E', '1', '\n'};
+
+inline bool parseOp(const std::string& op) {
+    if (op == "R" || op == "r" || op == "read" || op == "READ") return false;
+    if (op == "W" || op == "w" || op == "write" || op == "WRITE") return true;
+    throw std::runtime_error("unknown trace op '" + op + "'");
+}
+
+inline std::vector<TraceRecord> loadCsv(std::istream& in) {
+    std::vector<TraceRecord> records;
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+
+        // Paths may contain commas, so split on the first comma and the last two
+        size_t first = line.find(',');
+        size_t last = line.rfind(',');
+        size_t middle = last == std::string::npos || last == 0 ? std::string::npos : line.rfind(',', last - 1);
+        if (first == std::string::npos || middle == std::string::npos || middle <= first) {
+            throw std::runtime_error("malformed trace line " + std::to_string(lineNumber));
+        }
+
+        std::string timestamp = line.substr(0, first);
+        if (records.empty() && lineNumber == 1 && (timestamp.empty() || !isdigit(static_cast<unsigned char>(timestamp[0])))) {
+            continue;  // Header
+        }
+
+        TraceRecord record;
+        record.timestamp = std::stoull(timestamp);
+        record.path = line.substr(first + 1, middle - first - 1);
+        record.write = parseOp(line.substr(middle + 1, last - middle - 1));
+        record.size = std::stoull(line.substr(last + 1));
+        records.push_back(std::move(record));
+    }
+    return records;
+}
+
+template <typename T>
+inline void readRaw(std::istream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(value));
+}
+
+template <typename T>
+inline void writeRaw(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+inline std::vector<TraceRecord> loadBinary(std::istream& in) {
+    std::vector<TraceRecord> records;
+    while (true) {
+        TraceRecord record;
+        uint32_t pathLength;
+        uint8_t op;
+        readRaw(in, record.timestamp);
+        if (!in) break;
+        readRaw(in, pathLength);
+        record.path.resize(pathLength);
+        in.read(&record.path[0], pathLength);
+        readRaw(in, op);
+        readRaw(in, record.size);
+        if (!in) {
+            throw std::runtime_error("truncated binary trace");
+        }
+        record.write = op != 0;
+        records.push_back(std::move(record));
+    }
+    return records;
+}
+
+// Detects the format from the magic bytes
+inline std::vector<TraceRecord> load(const std::string& fileName) {
+    std::ifstream in(fileName, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("cannot open trace file '" + fileName + "'");
+    }
+    char magic[sizeof(binaryMagic)] = {};
+    in.read(magic, sizeof(magic));
+    if (in.gcount() == sizeof(magic) && std::memcmp(magic, binaryMagic, sizeof(magic)) == 0) {
+        return loadBinary(in);
+    }
+    in.clear();
+    in.seekg(0);
+    return loadCsv(in);
+}
+
+inline void writeBinaryHeader(std::ostream& out) {
+    out.write(binaryMagic, sizeof(binaryMagic));
+}
+
+inline void writeBinaryRecord(std::ostream& out, const TraceRecord& record) {
+    writeRaw(out, record.timestamp);
+    writeRaw(out, static_cast<uint32_t>(record.path.size()));
+    out.write(record.path.data(), record.path.size());
+    writeRaw(out, static_cast<uint8_t>(record.write ? 1 : 0));
+    writeRaw(out, record.size);
+}
+
+inline void writeCsvRecord(std::ostream& out, const TraceRecord& record) {
+    out << record.timestamp << ',' << record.path << ',' << (record.write ? 'W' : 'R') << ',' << record.size << '\n';
+}
+
+} // namespace trace
+
+#endif // TRACE_H
@@ -0,0 +1,252 @@
+#ifndef WORKLOAD_GENERATOR_H
+#define WORKLOAD_GENERATOR_H
+
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+// Synthetic access streams for the benchmark drivers.
+//
+// Patterns:
+//  - uniform: every key equally likely
+//  - zipf:    key k (0-based rank) drawn with probability proportional to 1/(k+1)^skew
+//  - loop:    keys 0..loopLength-1 in order, over and over (defeats LRU when larger than the cache)
+//  - hotspot: zipf whose hot set moves by `shift` keys every phaseLength operations
+// Any pattern can additionally start a sequential scan of scanLength keys from a random
+// position with probability scanProbability per operation, and issue writes with
+// probability writeRatio. The same spec and seed always produce the same stream.
+struct WorkloadSpec {
+    std::string pattern = "zipf";
+    uint64_t keys = 1000000;         // Size of the key universe
+    double skew = 0.99;              // Zipf exponent
+    double writeRatio = 0.0;
+    double scanProbability = 0.0;
+    uint64_t scanLength = 1000;
+    uint64_t loopLength = 1000;
+    uint64_t phaseLength = 100000;   // Operations per hotspot phase
+    uint64_t shift = 0;              // Hotspot movement per phase, 0 means keys / 4
+    uint64_t minSize = 4096;         // Per-key object size, log-uniform in [minSize, maxSize]
+    uint64_t maxSize = 4096;
+    uint64_t seed = 42;
+
+    // Parses "pattern:key=value,key=value", e.g. "zipf:keys=100000,skew=0.8,write=0.1,scan=0.01".
+    // Keys: keys, skew, write, scan, scanlen, loop, phase, shift, size, minsize, maxsize, seed.
+    static WorkloadSpec parse(const std::string& text) {
+        WorkloadSpec spec;
+        size_t colon = text.find(':');
+        spec.pattern = text.substr(0, colon);
+        if (spec.pattern != "uniform" && spec.pattern != "zipf" && spec.pattern != "loop" && spec.pattern != "hotspot") {
+            throw std::runtime_error("unknown workload pattern '" + spec.pattern + "'");
+        }
+        size_t start = colon == std::string::npos ? text.size() : colon + 1;
+        while (start < text.size()) {
+            size_t comma = text.find(',', start);
+            if (comma == std::string::npos) comma = text.size();
+            std::string option = text.substr(start, comma - start);
+            size_t equals = option.find('=');
+            if (equals == std::string::npos) {
+                throw std::runtime_error("workload option '" + option + "' needs a value");
+            }
+            std::string key = option.substr(0, equals), value = option.substr(equals + 1);
+            if (key == "keys") spec.keys = std::stoull(value);
+            else if (key == "skew") spec.skew = std::stod(value);
+            else if (key == "write") spec.writeRatio = std::stod(value);
+            else if (key == "scan") spec.scanProbability = std::stod(value);
+            else if (key == "scanlen") spec.scanLength = std::stoull(value);
+            else if (key == "loop") spec.loopLength = std::stoull(value);
+            else if (key == "phase") spec.phaseLength = std::stoull(value);
+            else if (key == "shift") spec.shift = std::stoull(value);
+            else if (key == "size") spec.minSize = spec.maxSize = std::stoull(value);
+            else if (key == "minsize") spec.minSize = std::stoull(value);
+            else if (key == "maxsize") spec.maxSize = std::stoull(value);
+            else if (key == "seed") spec.seed = std::stoull(value);
+            else throw std::runtime_error("unknown workload option '" + key + "'");
+            start = comma + 1;
+        }
+        if (spec.keys == 0 || spec.loopLength == 0 || spec.phaseLength == 0 || spec.scanLength == 0 ||
+            spec.minSize == 0 || spec.minSize > spec.maxSize) {
+            throw std::runtime_error("invalid workload '" + text + "'");
+        }
+        return spec;
+    }
+};
+
+// xoshiro256** seeded through splitmix64: a few ns per number, unlike std::mt19937_64
+class FastRandom {
+public:
+    explicit FastRandom(uint64_t seed) {
+        for (auto& word : state) {
+            seed += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, 1)
+    double nextDouble() {
+        return (next() >> 11) * 0x1.0p-53;
+    }
+
+    // Uniform in [0, bound), multiply-shift instead of a modulo
+    uint64_t nextBelow(uint64_t bound) {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(next()) * bound) >> 64);
+    }
+
+private:
+    uint64_t state[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+};
+
+// Zipf sampler using rejection-inversion (Hormann and Derflinger): O(1) time per sample
+// and no per-key table, so it works for universes of any size.
+class ZipfSampler {
+public:
+    ZipfSampler(uint64_t elements, double exponent) : n(elements), s(exponent) {
+        hIntegralX1 = hIntegral(1.5) - 1.0;
+        hIntegralN = hIntegral(n + 0.5);
+        threshold = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
+    }
+
+    // Rank in [0, n), 0 being the most popular
+    uint64_t sample(FastRandom& random) {
+        while (true) {
+            double u = hIntegralN + random.nextDouble() * (hIntegralX1 - hIntegralN);
+            double x = hIntegralInverse(u);
+            double k = std::floor(x + 0.5);
+            if (k < 1.0) k = 1.0;
+            else if (k > static_cast<double>(n)) k = static_cast<double>(n);
+            if (k - x <= threshold || u >= hIntegral(k + 0.5) - h(k)) {
+                return static_cast<uint64_t>(k) - 1;
+            }
+        }
+    }
+
+private:
+    uint64_t n;
+    double s;
+    double hIntegralX1, hIntegralN, threshold;
+
+    double h(double x) const { return std::exp(-s * std::log(x)); }
+
+    double hIntegral(double x) const {
+        double logX = std::log(x);
+        return helper2((1.0 - s) * logX) * logX;
+    }
+
+    double hIntegralInverse(double x) const {
+        double t = x * (1.0 - s);
+        if (t < -1.0) t = -1.0;
+        return std::exp(helper1(t) * x);
+    }
+
+    // log1p(x) / x and expm1(x) / x, with series expansions near zero
+    static double helper1(double x) {
+        return std::fabs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+
+    static double helper2(double x) {
+        return std::fabs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+    }
+};
+
+struct WorkloadOperation {
+    uint64_t key;
+    bool write;
+    uint64_t size;
+};
+
+class WorkloadGenerator {
+public:
+    explicit WorkloadGenerator(const WorkloadSpec& spec)
+        : spec(spec), random(spec.seed), zipf(spec.keys, spec.skew), operations(0), loopPosition(0),
+          scanRemaining(0), scanNext(0) {
+        hotspotShift = spec.shift ? spec.shift : spec.keys / 4;
+        if (spec.pattern == "uniform") pattern = Uniform;
+        else if (spec.pattern == "loop") pattern = Loop;
+        else if (spec.pattern == "hotspot") pattern = Hotspot;
+        else pattern = Zipf;
+    }
+
+    WorkloadOperation next() {
+        WorkloadOperation op;
+        op.key = nextKey();
+        op.write = spec.writeRatio > 0 && scanRemaining == 0 && random.nextDouble() < spec.writeRatio;
+        op.size = sizeOf(op.key);
+        operations++;
+        return op;
+    }
+
+    // Object size for a key; fixed per key so repeated accesses agree
+    uint64_t sizeOf(uint64_t key) const {
+        if (spec.minSize == spec.maxSize) return spec.minSize;
+        uint64_t h = key * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 29;
+        double fraction = (h >> 11) * 0x1.0p-53;
+        double size = spec.minSize * std::pow(static_cast<double>(spec.maxSize) / spec.minSize, fraction);
+        return static_cast<uint64_t>(size);
+    }
+
+    static std::string pathFor(uint64_t key) {
+        return "file" + std::to_string(key);
+    }
+
+private:
+    enum Pattern { Uniform, Zipf, Loop, Hotspot };
+
+    WorkloadSpec spec;
+    Pattern pattern;
+    FastRandom random;
+    ZipfSampler zipf;
+    uint64_t operations;
+    uint64_t loopPosition;
+    uint64_t scanRemaining;
+    uint64_t scanNext;
+    uint64_t hotspotShift;
+
+    uint64_t nextKey() {
+        if (scanRemaining > 0) {
+            scanRemaining--;
+            return scanNext++ % spec.keys;
+        }
+        if (spec.scanProbability > 0 && random.nextDouble() < spec.scanProbability) {
+            scanNext = random.nextBelow(spec.keys);
+            scanRemaining = spec.scanLength - 1;
+            return scanNext++ % spec.keys;
+        }
+
+        if (pattern == Uniform) {
+            return random.nextBelow(spec.keys);
+        }
+        if (pattern == Loop) {
+            uint64_t key = loopPosition;
+            loopPosition = (loopPosition + 1) % spec.loopLength;
+            return key % spec.keys;
+        }
+        uint64_t rank = zipf.sample(random);
+        if (pattern == Hotspot) {
+            uint64_t phase = operations / spec.phaseLength;
+            return (rank + phase * hotspotShift) % spec.keys;
+        }
+        return rank;
+    }
+};
+
+#endif // WORKLOAD_GENERATOR_H
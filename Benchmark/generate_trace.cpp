@@ -0,0 +1,69 @@
+// Writes a synthetic trace for trace_replay (or any other driver) from a workload spec.
+//
+// Build (from this directory):
+//   g++ -O2 -std=c++17 generate_trace.cpp -o generate_trace
+//
+// Usage:
+//   generate_trace --workload <spec> [--ops <n>] [--out <file.csv|file.bin>]
+//
+// See WorkloadSpec::parse for the spec syntax, e.g. "hotspot:keys=1000000,skew=0.9,phase=500000".
+// Files ending in .bin are written in the binary trace format, anything else as CSV;
+// without --out the CSV goes to stdout.
+#include "Trace.h"
+#include "WorkloadGenerator.h"
+#include <chrono>
+#include <iostream>
+
+int main(int argc, char* argv[]) {
+    std::string workload = "zipf", outFile;
+    uint64_t operations = 1000000;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) throw std::runtime_error("missing value for " + arg);
+            std::string value = argv[++i];
+            if (arg == "--workload") workload = value;
+            else if (arg == "--ops") operations = std::stoull(value);
+            else if (arg == "--out") outFile = value;
+            else throw std::runtime_error("unknown option " + arg);
+        }
+
+        WorkloadGenerator generator(WorkloadSpec::parse(workload));
+        bool binary = outFile.size() > 4 && outFile.compare(outFile.size() - 4, 4, ".bin") == 0;
+        std::ofstream file;
+        if (!outFile.empty()) {
+            file.open(outFile, std::ios::binary);
+            if (!file) throw std::runtime_error("cannot open '" + outFile + "'");
+        }
+        std::ostream& out = outFile.empty() ? std::cout : file;
+
+        if (binary) {
+            trace::writeBinaryHeader(out);
+        } else {
+            out << "timestamp,path,op,size\n";
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        TraceRecord record;
+        for (uint64_t i = 0; i < operations; ++i) {
+            WorkloadOperation op = generator.next();
+            record.timestamp = i;
+            record.path = WorkloadGenerator::pathFor(op.key);
+            record.write = op.write;
+            record.size = op.size;
+            if (binary) {
+                trace::writeBinaryRecord(out, record);
+            } else {
+                trace::writeCsvRecord(out, record);
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << "Wrote " << operations << " records in " << seconds << " s" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "generate_trace: " << e.what() << std::endl;
+        std::cerr << "Usage: " << argv[0] << " --workload <spec> [--ops <n>] [--out <file.csv|file.bin>]" << std::endl;
+        return 1;
+    }
+    return 0;
+}
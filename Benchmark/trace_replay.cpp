@@ -0,0 +1,237 @@
+// Replays a trace against any of the cache implementations and reports hit ratio,
+// byte hit ratio, throughput and per-operation latency percentiles.
+//
+// Build (from this directory):
+//   g++ -O2 -std=c++17 -pthread trace_replay.cpp Approach1Policy.cpp Approach2Policy.cpp
+//       ShardedPolicy.cpp ClockPolicy.cpp LfuPolicy.cpp ../Approach-2/ShardedCacheOptimizer.cpp -o trace_replay
+//
+// Usage:
+//   trace_replay (--trace <file> | --workload <spec> [--ops <n>]) [--policy <name,...|all>]
+//                [--capacity <entries,...>] [--capacity-bytes <bytes,...>] [--json <file|->]
+//
+// --workload replays a synthetic stream instead of a file (see WorkloadSpec::parse),
+// e.g. --workload zipf:keys=100000,skew=0.9,write=0.05 --ops 2000000.
+//
+// Policies: approach1 (Approach -1 CacheOptimizer), approach2 (Approach-2 CacheOptimizer),
+// sharded (ShardedCacheOptimizer), clock (ClockCache), lfu and tinylfu (the byte-budgeted
+// Cache from FileSystemCacheOptimizer.cpp, without and with the admission filter) and
+// slablfu (lfu with its content in the slab allocator).
+// --capacity is in entries. The byte-budgeted policies get capacity x mean record size
+// unless --capacity-bytes gives their budgets explicitly. K/M/G suffixes multiply by 1024.
+#include "CachePolicy.h"
+#include "WorkloadGenerator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+struct ReplayResult {
+    std::string policy;
+    size_t capacity;
+    bool capacityInBytes = false;
+    size_t operations = 0;
+    size_t hits = 0;
+    uint64_t bytes = 0;
+    uint64_t hitBytes = 0;
+    double seconds = 0.0;
+    std::vector<uint64_t> latencies;  // Nanoseconds per operation, sorted after the replay
+
+    double hitRatio() const { return operations ? (double)hits / operations : 0.0; }
+    double byteHitRatio() const { return bytes ? (double)hitBytes / bytes : 0.0; }
+    double opsPerSecond() const { return seconds > 0 ? operations / seconds : 0.0; }
+
+    uint64_t percentile(double q) const {
+        if (latencies.empty()) return 0;
+        size_t rank = static_cast<size_t>(std::ceil(q * latencies.size()));
+        return latencies[std::min(latencies.size() - 1, rank > 0 ? rank - 1 : 0)];
+    }
+};
+
+size_t parseSize(const std::string& text) {
+    size_t used = 0;
+    double value = std::stod(text, &used);
+    std::string suffix = text.substr(used);
+    if (suffix == "K" || suffix == "k") value *= 1024;
+    else if (suffix == "M" || suffix == "m") value *= 1024.0 * 1024;
+    else if (suffix == "G" || suffix == "g") value *= 1024.0 * 1024 * 1024;
+    else if (!suffix.empty()) throw std::runtime_error("bad size '" + text + "'");
+    return static_cast<size_t>(value);
+}
+
+std::vector<std::string> splitList(const std::string& text) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);
+        if (comma == std::string::npos) comma = text.size();
+        if (comma > start) items.push_back(text.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return items;
+}
+
+bool isByteBudgeted(const std::string& name) {
+    return name == "lfu" || name == "tinylfu" || name == "slablfu";
+}
+
+std::unique_ptr<CachePolicy> makePolicy(const std::string& name, size_t capacity, size_t meanSize) {
+    if (name == "approach1") return makeApproach1Policy(capacity);
+    if (name == "approach2") return makeApproach2Policy(capacity);
+    if (name == "sharded") return makeShardedPolicy(capacity);
+    if (name == "clock") return makeClockPolicy(capacity);
+    if (isByteBudgeted(name)) {
+        // Size the sketch for the number of average-sized files the budget holds
+        size_t expectedEntries = std::max<size_t>(16, capacity / std::max<size_t>(1, meanSize));
+        return makeLfuPolicy(capacity, expectedEntries, name == "tinylfu", name == "slablfu");
+    }
+    throw std::runtime_error("unknown policy '" + name + "'");
+}
+
+ReplayResult replay(const std::string& name, size_t capacity, const std::vector<TraceRecord>& records, size_t meanSize) {
+    ReplayResult result;
+    result.policy = name;
+    result.capacity = capacity;
+    result.capacityInBytes = isByteBudgeted(name);
+    result.latencies.reserve(records.size());
+    std::unique_ptr<CachePolicy> policy = makePolicy(name, capacity, meanSize);
+
+    // The implementations log every eviction; keep that out of the measurement
+    std::cout.setstate(std::ios::badbit);
+    auto start = std::chrono::steady_clock::now();
+    for (const TraceRecord& record : records) {
+        auto before = std::chrono::steady_clock::now();
+        bool hit = policy->access(record);
+        auto after = std::chrono::steady_clock::now();
+
+        result.latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count());
+        result.operations++;
+        result.bytes += record.size;
+        if (hit) {
+            result.hits++;
+            result.hitBytes += record.size;
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout.clear();
+
+    std::sort(result.latencies.begin(), result.latencies.end());
+    return result;
+}
+
+void printTable(const std::vector<ReplayResult>& results) {
+    std::cout << std::left << std::setw(11) << "Policy" << std::right << std::setw(12) << "Capacity"
+              << std::setw(11) << "Ops" << std::setw(10) << "Hit%" << std::setw(10) << "ByteHit%"
+              << std::setw(13) << "Ops/sec" << std::setw(10) << "p50(ns)" << std::setw(10) << "p99(ns)"
+              << std::setw(11) << "p999(ns)" << std::endl;
+    for (const auto& r : results) {
+        std::string capacity = std::to_string(r.capacity) + (r.capacityInBytes ? "B" : "");
+        std::cout << std::left << std::setw(11) << r.policy << std::right << std::setw(12) << capacity
+                  << std::setw(11) << r.operations << std::fixed << std::setprecision(2)
+                  << std::setw(10) << r.hitRatio() * 100 << std::setw(10) << r.byteHitRatio() * 100
+                  << std::setprecision(0) << std::setw(13) << r.opsPerSecond()
+                  << std::setw(10) << r.percentile(0.50) << std::setw(10) << r.percentile(0.99)
+                  << std::setw(11) << r.percentile(0.999) << std::endl;
+    }
+}
+
+void writeJson(std::ostream& out, const std::string& traceFile, const std::vector<ReplayResult>& results) {
+    out << std::setprecision(6) << "{\n  \"trace\": \"" << traceFile << "\",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        out << "    {\"policy\": \"" << r.policy << "\", \"capacity\": " << r.capacity
+            << ", \"capacity_unit\": \"" << (r.capacityInBytes ? "bytes" : "entries") << "\""
+            << ", \"operations\": " << r.operations << ", \"hits\": " << r.hits
+            << ", \"hit_ratio\": " << r.hitRatio() << ", \"byte_hit_ratio\": " << r.byteHitRatio()
+            << ", \"ops_per_sec\": " << r.opsPerSecond()
+            << ", \"latency_ns\": {\"p50\": " << r.percentile(0.50) << ", \"p99\": " << r.percentile(0.99)
+            << ", \"p999\": " << r.percentile(0.999) << ", \"max\": " << r.percentile(1.0) << "}}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char* argv[]) {
+    std::string traceFile, workload, jsonFile;
+    uint64_t workloadOps = 1000000;
+    std::vector<std::string> policies = {"approach1"};
+    std::vector<size_t> capacities = {1000};
+    std::vector<size_t> byteCapacities;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) throw std::runtime_error("missing value for " + arg);
+            std::string value = argv[++i];
+            if (arg == "--trace") {
+                traceFile = value;
+            } else if (arg == "--workload") {
+                workload = value;
+            } else if (arg == "--ops") {
+                workloadOps = std::stoull(value);
+            } else if (arg == "--policy") {
+                policies = value == "all" ? std::vector<std::string>{"approach1", "approach2", "sharded", "clock", "lfu", "tinylfu", "slablfu"}
+                                          : splitList(value);
+            } else if (arg == "--capacity") {
+                capacities.clear();
+                for (const auto& item : splitList(value)) capacities.push_back(parseSize(item));
+            } else if (arg == "--capacity-bytes") {
+                byteCapacities.clear();
+                for (const auto& item : splitList(value)) byteCapacities.push_back(parseSize(item));
+            } else if (arg == "--json") {
+                jsonFile = value;
+            } else {
+                throw std::runtime_error("unknown option " + arg);
+            }
+        }
+        if (traceFile.empty() == workload.empty()) {
+            throw std::runtime_error("exactly one of --trace and --workload is required");
+        }
+
+        std::vector<TraceRecord> records;
+        if (!traceFile.empty()) {
+            records = trace::load(traceFile);
+        } else {
+            WorkloadGenerator generator(WorkloadSpec::parse(workload));
+            records.reserve(workloadOps);
+            for (uint64_t i = 0; i < workloadOps; ++i) {
+                WorkloadOperation op = generator.next();
+                records.push_back({i, WorkloadGenerator::pathFor(op.key), op.write, op.size});
+            }
+            traceFile = workload;
+        }
+        uint64_t totalBytes = 0;
+        for (const auto& record : records) totalBytes += record.size;
+        size_t meanSize = records.empty() ? 1 : static_cast<size_t>(totalBytes / records.size());
+        std::cerr << "Loaded " << records.size() << " records from " << traceFile << std::endl;
+
+        std::vector<ReplayResult> results;
+        for (const auto& policy : policies) {
+            if (isByteBudgeted(policy) && !byteCapacities.empty()) {
+                for (size_t capacity : byteCapacities) {
+                    results.push_back(replay(policy, capacity, records, meanSize));
+                }
+                continue;
+            }
+            for (size_t capacity : capacities) {
+                size_t budget = isByteBudgeted(policy) ? capacity * meanSize : capacity;
+                results.push_back(replay(policy, budget, records, meanSize));
+            }
+        }
+
+        printTable(results);
+        if (jsonFile == "-") {
+            writeJson(std::cout, traceFile, results);
+        } else if (!jsonFile.empty()) {
+            std::ofstream out(jsonFile);
+            writeJson(out, traceFile, results);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "trace_replay: " << e.what() << std::endl;
+        std::cerr << "Usage: " << argv[0] << " (--trace <file> | --workload <spec> [--ops <n>]) [--policy <name,...|all>]"
+                  << " [--capacity <entries,...>] [--capacity-bytes <bytes,...>] [--json <file|->]" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -4,79 +4,275 @@
 #include <string>
 #include <random>
 #include <chrono>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <memory>
+#include <functional>
+#include "Benchmark/WorkloadGenerator.h"
+#include "GhostList.h"
 
 using namespace std;
 
+// Slot payload. The reference bits live apart in ClockCache::referenced, so the clock
+// sweep never touches these cache lines.
 struct CacheEntry {
     string filename;
     string data;
-    bool used;
 };
 
+// CLOCK cache that is safe to share between threads.
+// A hit takes only a shared lock on one index stripe, does a single lookup and sets the
+// slot's reference bit, so concurrent hits never exclude each other.
+// Misses are serialized by missLock, which also owns the clock hand; replacing a slot
+// additionally takes the affected stripes exclusively so no reader sees it half-written.
+//
+// Reference bits are packed 64 to a word. The hand skips and clears a whole word of set
+// bits at once and finds the next clear bit with a count-trailing-zeros, so an eviction
+// reads at most capacity / 8 bytes of bitmap (128 KB at a million entries) instead of
+// every entry it passes.
 class ClockCache {
 public:
-    ClockCache(int capacity) : capacity(capacity), pointer(0), hits(0), misses(0) {}
-
-    string accessFile(const string& filename) {
-        totalAccesses++;
-        if (cacheMap.find(filename) != cacheMap.end()) {
-            cacheEntries[cacheMap[filename]].used = true;
-            hits++;
-            cout << "Accessed: " << filename << " (Cache Hit)\n";
-            displayCache(); // Display cache contents after each access
-            return cacheEntries[cacheMap[filename]].data;
+    ClockCache(int capacity, bool verbose = true, int stripeCount = 64)
+        : capacity(capacity), verbose(verbose), pointer(0), filled(0),
+          cacheEntries(new CacheEntry[capacity > 0 ? capacity : 0]),
+          words(capacity > 0 ? (capacity + 63) / 64 : 0),
+          referenced(new atomic<uint64_t>[words]()),
+          stripes(stripeCount > 0 ? stripeCount : 1) {}
+
+    // `hit`, if given, is set to whether the file was served from the cache
+    string accessFile(const string& filename, bool* hit = nullptr) {
+        IndexStripe& stripe = stripeFor(filename);
+        {
+            shared_lock<shared_mutex> guard(stripe.lock);
+            auto it = stripe.slots.find(filename);
+            if (it != stripe.slots.end()) {
+                markReferenced(it->second);
+                stripe.hits.fetch_add(1, memory_order_relaxed);
+                string data = cacheEntries[it->second].data;
+                guard.unlock();
+                if (ghosts) {
+                    lock_guard<mutex> estimateGuard(estimateLock);
+                    lookups++;
+                    shadow->hit(filename);
+                }
+                if (hit) *hit = true;
+                if (verbose) {
+                    cout << "Accessed: " << filename << " (Cache Hit)\n";
+                    displayCache(); // Display cache contents after each access
+                }
+                return data;
+            }
         }
-        misses++;
-        string data = generateData(filename);
-        if (cacheEntries.size() < capacity) {
-            cacheEntries.push_back({filename, data, true});
-            cacheMap[filename] = cacheEntries.size() - 1;
-        } else {
-            evictAndInsert(filename, data);
+        string data = handleMiss(filename, stripe);
+        if (hit) *hit = false;
+        if (verbose) {
+            cout << "Accessed: " << filename << " (Cache Miss)\n";
+            displayCache(); // Display cache contents after each access
         }
-        cout << "Accessed: " << filename << " (Cache Miss)\n";
-        displayCache(); // Display cache contents after each access
         return data;
     }
 
     void displayCache() const {
+        lock_guard<mutex> guard(missLock);  // Slots only change while missLock is held
         cout << "Cache Contents: ";
-        for (const auto& entry : cacheEntries) {
-            cout << entry.filename << " ";
+        for (int i = 0; i < filled; ++i) {
+            cout << cacheEntries[i].filename << " ";
         }
         cout << "\n"<<endl;
     }
 
     void displayMetrics() const {
+        long long hits = 0, misses = 0;
+        for (const auto& stripe : stripes) {
+            hits += stripe.hits.load(memory_order_relaxed);
+            misses += stripe.misses.load(memory_order_relaxed);
+        }
+        long long totalAccesses = hits + misses;
         cout << "Performance Metrics:\n";
         cout << "Total Accesses: " << totalAccesses << "\n";
         cout << "Cache Hits: " << hits << "\n";
         cout << "Cache Misses: " << misses << "\n";
         double hitRate = (totalAccesses > 0) ? (static_cast<double>(hits) / totalAccesses) * 100.0 : 0.0;
         cout << "Hit Rate: " << hitRate << "%\n";
+        if (ghosts) {
+            CapacityEstimate estimate = capacityEstimate();
+            cout << "Capacity what-if over " << estimate.accesses << " lookups:\n";
+            estimate.print(cout, "entries");
+        }
+    }
+
+    // Counts the hits a cache stepEntries, 2 * stepEntries, ... larger would have added and
+    // one stepEntries smaller would have lost (see GhostList.h). The shadow counter ranks
+    // entries by recency, which CLOCK only approximates. Hits then also take estimateLock,
+    // so this is for sizing runs; call before the cache is shared between threads.
+    void enableCapacityEstimates(int stepEntries, int steps = 4) {
+        lock_guard<mutex> guard(missLock);
+        lock_guard<mutex> estimateGuard(estimateLock);
+        size_t step = stepEntries > 0 ? stepEntries : 1;
+        ghosts = make_unique<GhostList>(step, steps);
+        shadow = make_unique<ShadowTier>(capacity > static_cast<int>(step) ? capacity - step : 0);
+        lookups = 0;
+        for (int i = 0; i < filled; ++i) {
+            shadow->inserted(cacheEntries[i].filename, 1);
+        }
+    }
+
+    // Counts since enableCapacityEstimates, in entries; empty if it was not called
+    CapacityEstimate capacityEstimate() const {
+        lock_guard<mutex> estimateGuard(estimateLock);
+        CapacityEstimate estimate;
+        if (!ghosts) return estimate;
+        estimate.step = ghosts->stepSize();
+        estimate.extraHits = ghosts->extraHits();
+        estimate.lostHits = shadow->lostHits();
+        estimate.accesses = lookups;
+        return estimate;
     }
 
 private:
+    // One slice of the filename -> slot index; cache-line aligned so stripes do not false-share
+    struct alignas(64) IndexStripe {
+        mutable shared_mutex lock;
+        unordered_map<string, int> slots;
+        atomic<long long> hits{0};
+        atomic<long long> misses{0};
+    };
+
     int capacity;
-    int pointer;
-    vector<CacheEntry> cacheEntries;
-    unordered_map<string, int> cacheMap;
-    int hits;
-    int misses;
-    int totalAccesses = 0;
-
-    void evictAndInsert(const string& filename, const string& data) {
-        while (true) {
-            if (!cacheEntries[pointer].used) {
-                cacheMap.erase(cacheEntries[pointer].filename);
-                cacheEntries[pointer] = {filename, data, true};
-                cacheMap[filename] = pointer;
-                pointer = (pointer + 1) % capacity;
-                break;
+    bool verbose;
+    int pointer;  // Clock hand, guarded by missLock
+    int filled;   // Slots in use before the first eviction, guarded by missLock
+    unique_ptr<CacheEntry[]> cacheEntries;  // Fixed size, so readers never see a reallocation
+    int words;
+    unique_ptr<atomic<uint64_t>[]> referenced;  // Bit i % 64 of word i / 64 is slot i's reference bit
+    vector<IndexStripe> stripes;
+    mutable mutex missLock;
+    // Capacity estimates, when enabled. Taken after missLock and stripe locks, never before.
+    unique_ptr<GhostList> ghosts;
+    unique_ptr<ShadowTier> shadow;
+    long long lookups = 0;
+    mutable mutex estimateLock;
+
+    // Most hits find the bit already set and leave the word's cache line shared
+    void markReferenced(int slot) {
+        atomic<uint64_t>& word = referenced[slot / 64];
+        uint64_t bit = uint64_t(1) << (slot % 64);
+        if (!(word.load(memory_order_relaxed) & bit)) {
+            word.fetch_or(bit, memory_order_relaxed);
+        }
+    }
+
+    IndexStripe& stripeFor(const string& filename) {
+        size_t h = hash<string>{}(filename);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return stripes[h % stripes.size()];
+    }
+
+    string handleMiss(const string& filename, IndexStripe& stripe) {
+        string data = generateData(filename);  // Load outside the lock
+        lock_guard<mutex> guard(missLock);
+        stripe.misses.fetch_add(1, memory_order_relaxed);
+        if (ghosts) {
+            lock_guard<mutex> estimateGuard(estimateLock);
+            lookups++;
+            ghosts->missed(filename);
+        }
+        if (capacity <= 0) {
+            return data;
+        }
+
+        // Another thread may have inserted the file while we were loading it.
+        // Every index writer holds missLock, so reading the stripe here needs no extra lock.
+        auto it = stripe.slots.find(filename);
+        if (it != stripe.slots.end()) {
+            markReferenced(it->second);
+            return data;
+        }
+
+        if (filled < capacity) {
+            int slot = filled++;
+            unique_lock<shared_mutex> indexGuard(stripe.lock);
+            cacheEntries[slot].filename = filename;
+            cacheEntries[slot].data = data;
+            markReferenced(slot);
+            stripe.slots.emplace(filename, slot);
+            if (ghosts) {
+                lock_guard<mutex> estimateGuard(estimateLock);
+                shadow->inserted(filename, 1);
             }
-            cacheEntries[pointer].used = false;
-            pointer = (pointer + 1) % capacity;
+        } else {
+            evictAndInsert(filename, data, stripe);
         }
+        return data;
+    }
+
+    // Advances the hand to the first slot whose reference bit is clear, clearing the set
+    // bits it passes, and returns that slot. A word the hand passes entirely is cleared
+    // with a plain store: a hit landing between its load and that store loses its bit,
+    // the same race the per-slot flags had. Part of a word is cleared with fetch_and so
+    // hits on the slots ahead are kept. If concurrent hits keep setting bits ahead of the
+    // hand, the slot under it is taken after two revolutions, which bounds the sweep at
+    // 2 * words + 1 word visits. Caller holds missLock.
+    int sweep() {
+        for (int visited = 0; visited <= 2 * words; ++visited) {
+            int word = pointer / 64;
+            int first = pointer % 64;
+            int end = min(64, capacity - word * 64);  // The last word may be partial
+            uint64_t ahead = (end == 64 ? ~uint64_t(0) : (uint64_t(1) << end) - 1) & (~uint64_t(0) << first);
+
+            uint64_t clear = ~referenced[word].load(memory_order_relaxed) & ahead;
+            if (clear) {
+                int victim = word * 64 + __builtin_ctzll(clear);
+                uint64_t passed = ahead & ((uint64_t(1) << (victim % 64)) - 1);
+                if (passed) {
+                    referenced[word].fetch_and(~passed, memory_order_relaxed);
+                }
+                pointer = victim + 1 == capacity ? 0 : victim + 1;
+                return victim;
+            }
+            if (ahead == ~uint64_t(0)) {
+                referenced[word].store(0, memory_order_relaxed);
+            } else {
+                referenced[word].fetch_and(~ahead, memory_order_relaxed);
+            }
+            pointer = (word + 1) * 64 >= capacity ? 0 : (word + 1) * 64;
+        }
+        int victim = pointer;
+        pointer = (pointer + 1) % capacity;
+        return victim;
+    }
+
+    // Caller holds missLock
+    void evictAndInsert(const string& filename, const string& data, IndexStripe& stripe) {
+        // A concurrent hit may set the victim's bit after the sweep; it is still
+        // evicted, which only costs that reader one extra miss later.
+        int victim = sweep();
+
+        CacheEntry& entry = cacheEntries[victim];
+        IndexStripe& oldStripe = stripeFor(entry.filename);
+        unique_lock<shared_mutex> oldGuard(oldStripe.lock, defer_lock);
+        unique_lock<shared_mutex> newGuard(stripe.lock, defer_lock);
+        if (&oldStripe == &stripe) {
+            newGuard.lock();
+        } else {
+            lock(oldGuard, newGuard);
+        }
+
+        oldStripe.slots.erase(entry.filename);
+        if (ghosts) {
+            lock_guard<mutex> estimateGuard(estimateLock);
+            ghosts->evicted(entry.filename, 1);
+            shadow->removed(entry.filename);
+            shadow->inserted(filename, 1);
+        }
+        entry.filename = filename;
+        entry.data = data;
+        markReferenced(victim);
+        stripe.slots.emplace(filename, victim);
     }
 
     string generateData(const string& filename) {
@@ -84,22 +280,74 @@ private:
     }
 };
 
-int main() {
+// Hit-heavy throughput with several threads sharing one cache
+void runConcurrentSimulation(int threadCount, int capacity, int accessesPerThread) {
+    ClockCache cache(capacity, false);
+    vector<string> filenames;
+    for (int i = 0; i < capacity * 105 / 100; ++i) {  // ~95% of accesses fit in the cache
+        filenames.push_back("file" + to_string(i) + ".txt");
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+    vector<thread> workers;
+    for (int t = 0; t < threadCount; ++t) {
+        workers.emplace_back([&, t] {
+            WorkloadSpec spec = WorkloadSpec::parse("uniform");
+            spec.keys = filenames.size();
+            spec.seed = t;
+            WorkloadGenerator workload(spec);
+            for (int i = 0; i < accessesPerThread; ++i) {
+                cache.accessFile(filenames[workload.next().key]);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - start;
+
+    cout << "Threads: " << threadCount << " | Throughput: "
+         << static_cast<long long>(threadCount * accessesPerThread / elapsed.count()) << " accesses/s\n";
+}
+
+// Worst case for the clock hand: every reference bit is set, so one miss sweeps all slots
+void measureFullSweep(int capacity) {
+    ClockCache cache(capacity, false);
+    vector<string> filenames;
+    for (int i = 0; i < capacity; ++i) {
+        filenames.push_back("file" + to_string(i) + ".txt");
+    }
+    for (int round = 0; round < 2; ++round) {  // Fill, then hit every slot
+        for (const string& filename : filenames) {
+            cache.accessFile(filename);
+        }
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+    cache.accessFile("uncached.txt");
+    chrono::duration<double, micro> elapsed = chrono::high_resolution_clock::now() - start;
+    cout << "Entries: " << capacity << " | Full-sweep eviction: " << elapsed.count() << " us\n";
+}
+
+// Usage: ClockCache [workload spec] [accesses] [--stress], e.g. ClockCache "loop:loop=6" 30
+// --stress adds the multi-threaded throughput runs and the full-sweep timings (up to 1M entries)
+int main(int argc, char* argv[]) {
+    bool stress = argc > 1 && string(argv[argc - 1]) == "--stress";
+    if (stress) argc--;
+
     // Setup
     ClockCache cache(5);
+    cache.enableCapacityEstimates(1, 2);  // What one file more or less of capacity would change
     vector<string> filenames = {"file1.txt", "file2.txt", "file3.txt", "file4.txt", "file5.txt", "file6.txt", "file7.txt", "file8.txt", "file9.txt", "file10.txt"};
     
-    // Random access simulation
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_int_distribution<> dis(0, static_cast<int>(filenames.size()) - 1);
-    int simulationRuns = 10;
+    // Deterministic, skewed access stream so runs can be compared (see WorkloadSpec::parse)
+    WorkloadGenerator workload(WorkloadSpec::parse(argc > 1 ? argv[1] : "zipf:keys=10,skew=0.8,seed=1"));
+    int simulationRuns = argc > 2 ? stoi(argv[2]) : 10;
 
     auto start = chrono::high_resolution_clock::now();
 
     for (int i = 0; i < simulationRuns; ++i) {
-        int idx = dis(gen);
-        cache.accessFile(filenames[idx]);
+        cache.accessFile(filenames[workload.next().key % filenames.size()]);
     }
 
     auto end = chrono::high_resolution_clock::now();
@@ -108,6 +356,19 @@ int main() {
     // Display final results
     cache.displayMetrics();
     cout << "Simulation Time: " << elapsed.count() << " seconds\n";
+    if (!stress) {
+        return 0;
+    }
+
+    cout << "\nConcurrent simulation (hit-heavy):\n";
+    for (int threads : {1, 2, 4, 8, 16}) {
+        runConcurrentSimulation(threads, 10000, 200000);
+    }
+
+    cout << "\nWorst-case eviction (every reference bit set):\n";
+    for (int entries : {100000, 1000000}) {
+        measureFullSweep(entries);
+    }
 
     return 0;
 }
@@ -4,182 +4,833 @@
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/epoll.h>
 #include <sys/inotify.h>
+#include <sys/signalfd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <sys/mman.h>
 #include <linux/limits.h>
 #include <time.h>
 #include <stdbool.h>
 
-#define EVENT_SIZE (sizeof(struct inotify_event))
-#define EVENT_BUF_LEN (1024 * (EVENT_SIZE + 16))
-#define EVENT_COOLDOWN_SECONDS 2
+#define EVENT_BUF_LEN (64 * 1024)
+#define DEFAULT_COOLDOWN_SECONDS 2
+#define DEFAULT_WORKERS 4
+#define DEFAULT_QUEUE_LENGTH 4096
+#define MAX_WORKERS 256
+#define MAX_QUEUE_LENGTH (1 << 20)
+#define WATCH_MASK (IN_ACCESS | IN_MODIFY | IN_CREATE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+
+static bool verbose = false;
+
+// Cooldown state: the last time each file was acted on, in a hash table by path. Entries
+// are also kept in order of that time, so those older than the cooldown, which would
+// allow the next event anyway, are expired oldest first without scanning the table.
 
 typedef struct FileEvent {
-    char filename[PATH_MAX];
-    time_t last_event_time;
-    struct FileEvent *next;
+    char *filename;
+    uint64_t hash;
+    uint64_t last_event_ms;
+    struct FileEvent *next;             // Next in the same hash bucket
+    struct FileEvent *older, *newer;    // Neighbours in last_event_ms order
 } FileEvent;
 
-FileEvent *event_list = NULL;
+static FileEvent **event_buckets = NULL;
+static size_t event_bucket_count = 0;   // A power of two
+static size_t event_count = 0;
+static FileEvent *oldest_event = NULL, *newest_event = NULL;
+static uint64_t cooldown_ms = DEFAULT_COOLDOWN_SECONDS * 1000;
+
+static uint64_t now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static uint64_t hash_path(const char *path) {
+    uint64_t hash = 1469598103934665603ULL;   // FNV-1a
+    for (; *path; path++) {
+        hash = (hash ^ (unsigned char)*path) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void unlink_event_order(FileEvent *event) {
+    if (event->older) event->older->newer = event->newer; else oldest_event = event->newer;
+    if (event->newer) event->newer->older = event->older; else newest_event = event->older;
+}
+
+static void append_event_order(FileEvent *event) {
+    event->older = newest_event;
+    event->newer = NULL;
+    if (newest_event) newest_event->newer = event; else oldest_event = event;
+    newest_event = event;
+}
+
+static bool grow_event_buckets(void) {
+    size_t count = event_bucket_count ? event_bucket_count * 2 : 1024;
+    FileEvent **buckets = calloc(count, sizeof(FileEvent *));
+    if (!buckets) {
+        perror("calloc");
+        return false;
+    }
+    for (size_t i = 0; i < event_bucket_count; i++) {
+        FileEvent *event = event_buckets[i];
+        while (event) {
+            FileEvent *next = event->next;
+            event->next = buckets[event->hash & (count - 1)];
+            buckets[event->hash & (count - 1)] = event;
+            event = next;
+        }
+    }
+    free(event_buckets);
+    event_buckets = buckets;
+    event_bucket_count = count;
+    return true;
+}
 
 bool should_process_event(const char *filename) {
-    time_t current_time = time(NULL);
-    FileEvent *current = event_list;
+    uint64_t current_time = now_ms();
+    uint64_t hash = hash_path(filename);
 
-    while (current) {
-        if (strcmp(current->filename, filename) == 0) {
-            if (difftime(current_time, current->last_event_time) < EVENT_COOLDOWN_SECONDS) {
-                return false;
+    if (event_bucket_count) {
+        for (FileEvent *current = event_buckets[hash & (event_bucket_count - 1)]; current; current = current->next) {
+            if (current->hash == hash && strcmp(current->filename, filename) == 0) {
+                if (current_time - current->last_event_ms < cooldown_ms) {
+                    return false;
+                }
+                current->last_event_ms = current_time;
+                unlink_event_order(current);
+                append_event_order(current);
+                return true;
             }
-            current->last_event_time = current_time;
-            return true;
         }
-        current = current->next;
     }
 
-    // Add new file to the event list
+    // Add new file to the cooldown table
+    if (event_count >= event_bucket_count && !grow_event_buckets()) {
+        return true;
+    }
     FileEvent *new_event = malloc(sizeof(FileEvent));
-    if (!new_event) {
+    if (!new_event || !(new_event->filename = strdup(filename))) {
         perror("malloc");
-        return false;
+        free(new_event);
+        return true;
     }
-    strncpy(new_event->filename, filename, PATH_MAX);
-    new_event->last_event_time = current_time;
-    new_event->next = event_list;
-    event_list = new_event;
-
+    new_event->hash = hash;
+    new_event->last_event_ms = current_time;
+    new_event->next = event_buckets[hash & (event_bucket_count - 1)];
+    event_buckets[hash & (event_bucket_count - 1)] = new_event;
+    append_event_order(new_event);
+    event_count++;
     return true;
 }
 
-void preload_file(const char *filename) {
-    printf("[DEBUG] Preloading file: %s\n", filename);
+// Forget files whose cooldown has passed
+void expire_events(void) {
+    uint64_t current_time = now_ms();
+    while (oldest_event && current_time - oldest_event->last_event_ms >= cooldown_ms) {
+        FileEvent *event = oldest_event;
+        FileEvent **link = &event_buckets[event->hash & (event_bucket_count - 1)];
+        while (*link != event) {
+            link = &(*link)->next;
+        }
+        *link = event->next;
+        unlink_event_order(event);
+        free(event->filename);
+        free(event);
+        event_count--;
+    }
+}
+
+void free_events(void) {
+    while (oldest_event) {
+        FileEvent *event = oldest_event;
+        unlink_event_order(event);
+        free(event->filename);
+        free(event);
+    }
+    free(event_buckets);
+    event_buckets = NULL;
+    event_bucket_count = event_count = 0;
+}
 
-    int fd = open(filename, O_RDONLY);
+// Page-cache control works on byte ranges of an open file descriptor: readahead() pulls
+// a range in, posix_fadvise(DONTNEED) drops it, so no part of the file is ever mapped.
+// Preloads go in chunks of chunk_bytes, paced by a rate limit shared by all workers so
+// that warming cannot take the disk away from foreground reads.
+
+static off_t chunk_bytes = 4 << 20;
+static double rate_limit_bytes = 0;          // Per second over all workers; 0 for none
+static off_t warm_limit = 0;                 // Bytes preloaded from the start of a file; 0 for all
+static pthread_mutex_t rate_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t rate_next_us = 0;            // When the next chunk may start
+static atomic_bool shutting_down = false;    // Preloads in progress stop at the next chunk
+
+static uint64_t now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+// Waits for the rate limit to allow `bytes` more of I/O
+static void pace_io(off_t bytes) {
+    if (rate_limit_bytes <= 0) return;
+    pthread_mutex_lock(&rate_lock);
+    uint64_t now = now_us();
+    uint64_t start = rate_next_us > now ? rate_next_us : now;
+    rate_next_us = start + (uint64_t)(bytes * 1e6 / rate_limit_bytes);
+    pthread_mutex_unlock(&rate_lock);
+    if (start > now) {
+        struct timespec delay = {(time_t)((start - now) / 1000000), (long)((start - now) % 1000000) * 1000};
+        nanosleep(&delay, NULL);
+    }
+}
+
+// Opens a file and clamps [offset, offset + length) to its size; length 0 means to the
+// end. Returns -1 if the file cannot be opened or the range is empty.
+static int open_range(const char *filename, off_t *offset, off_t *length) {
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
     if (fd < 0) {
         perror("open");
-        return;
+        return -1;
     }
-
     struct stat file_stat;
     if (fstat(fd, &file_stat) < 0) {
         perror("fstat");
         close(fd);
+        return -1;
+    }
+    off_t end = *length > 0 && *offset + *length < file_stat.st_size ? *offset + *length : file_stat.st_size;
+    if (*offset >= end) {
+        close(fd);
+        return -1;
+    }
+    *length = end - *offset;
+    return fd;
+}
+
+void preload_file(const char *filename, off_t offset, off_t length) {
+    int fd = open_range(filename, &offset, &length);
+    if (fd < 0) {
         return;
     }
+    printf("[DEBUG] Preloading file: %s (bytes %lld-%lld)\n", filename, (long long)offset,
+           (long long)(offset + length));
 
-    void *map = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    if (map == MAP_FAILED) {
-        perror("mmap");
-        close(fd);
+    off_t done = 0;
+    while (done < length && !atomic_load(&shutting_down)) {
+        off_t chunk = length - done < chunk_bytes ? length - done : chunk_bytes;
+        pace_io(chunk);
+        // readahead() is Linux-only and refuses some file types; fadvise is the fallback
+        if (readahead(fd, offset + done, chunk) < 0) {
+            int error = posix_fadvise(fd, offset + done, chunk, POSIX_FADV_WILLNEED);
+            if (error) {
+                fprintf(stderr, "posix_fadvise: %s\n", strerror(error));
+                break;
+            }
+        }
+        done += chunk;
+    }
+    if (done == length) {
+        printf("Preloaded file into cache: %s (%lld bytes)\n", filename, (long long)length);
+    }
+    close(fd);
+}
+
+// Drops a range from the page cache. Dirty pages are only dropped once written back,
+// which DONTNEED starts.
+void evict_file(const char *filename, off_t offset, off_t length) {
+    int fd = open_range(filename, &offset, &length);
+    if (fd < 0) {
         return;
     }
+    printf("[DEBUG] Evicting file: %s (bytes %lld-%lld)\n", filename, (long long)offset,
+           (long long)(offset + length));
 
-    if (madvise(map, file_stat.st_size, MADV_WILLNEED) < 0) {
-        perror("madvise");
+    int error = posix_fadvise(fd, offset, length, POSIX_FADV_DONTNEED);
+    if (error) {
+        fprintf(stderr, "posix_fadvise: %s\n", strerror(error));
     } else {
-        printf("Preloaded file into cache: %s\n", filename);
+        printf("Evicted file from cache: %s (size: %lld bytes)\n", filename, (long long)length);
     }
-
-    munmap(map, file_stat.st_size);
     close(fd);
 }
 
-void evict_file(const char *filename) {
-    printf("[DEBUG] Evicting file: %s\n", filename);
+// Hot ranges, loaded once from the -R file and read-only after: a file listed there has
+// only its listed ranges preloaded. Each line is "offset length path", with the path as
+// the daemon reports it (the monitored directory as given, then the relative path) and a
+// length of 0 meaning to the end of the file.
 
-    int fd = open(filename, O_RDONLY);
-    if (fd < 0) {
-        perror("open");
+typedef struct HotRange {
+    char *path;
+    uint64_t hash;
+    off_t offset, length;
+    struct HotRange *next;   // Next in the same hash bucket
+} HotRange;
+
+static HotRange **range_buckets = NULL;
+static size_t range_bucket_count = 0;   // A power of two
+
+bool load_hot_ranges(const char *ranges_path) {
+    FILE *file = fopen(ranges_path, "r");
+    if (!file) {
+        perror("fopen");
+        return false;
+    }
+    HotRange *loaded = NULL;
+    size_t count = 0;
+    char line[PATH_MAX + 64];
+    while (fgets(line, sizeof(line), file)) {
+        long long offset, length;
+        int path_start = 0;
+        line[strcspn(line, "\n")] = '\0';
+        if (line[0] == '#' || sscanf(line, "%lld %lld %n", &offset, &length, &path_start) < 2 || !path_start ||
+            !line[path_start] || offset < 0 || length < 0) {
+            continue;
+        }
+        HotRange *range = malloc(sizeof(HotRange));
+        if (!range || !(range->path = strdup(line + path_start))) {
+            perror("malloc");
+            free(range);
+            break;
+        }
+        range->hash = hash_path(range->path);
+        range->offset = offset;
+        range->length = length;
+        range->next = loaded;
+        loaded = range;
+        count++;
+    }
+    fclose(file);
+
+    for (range_bucket_count = 16; range_bucket_count < count; range_bucket_count *= 2) {
+    }
+    range_buckets = calloc(range_bucket_count, sizeof(HotRange *));
+    if (!range_buckets) {
+        perror("calloc");
+        range_bucket_count = 0;
+        return false;
+    }
+    while (loaded) {
+        HotRange *range = loaded;
+        loaded = range->next;
+        range->next = range_buckets[range->hash & (range_bucket_count - 1)];
+        range_buckets[range->hash & (range_bucket_count - 1)] = range;
+    }
+    printf("Loaded %zu hot ranges from %s\n", count, ranges_path);
+    return true;
+}
+
+void free_hot_ranges(void) {
+    for (size_t i = 0; i < range_bucket_count; i++) {
+        while (range_buckets[i]) {
+            HotRange *range = range_buckets[i];
+            range_buckets[i] = range->next;
+            free(range->path);
+            free(range);
+        }
+    }
+    free(range_buckets);
+    range_buckets = NULL;
+    range_bucket_count = 0;
+}
+
+// Worker pool: the event loop queues preloads and evictions and returns to reading events
+// at once. The queue is bounded; when it is full a job is dropped rather than the loop
+// blocking, since inotify drops events itself once its own queue overflows.
+
+typedef enum { JOB_PRELOAD, JOB_EVICT } JobKind;
+
+typedef struct {
+    JobKind kind;
+    char *path;
+    off_t offset, length;    // Byte range; a length of 0 runs to the end of the file
+} Job;
+
+static Job *jobs = NULL;
+static size_t job_capacity = DEFAULT_QUEUE_LENGTH;
+static size_t job_head = 0, job_count = 0;
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_ready = PTHREAD_COND_INITIALIZER;
+static bool workers_stopping = false;
+static pthread_t *workers = NULL;
+static int worker_count = DEFAULT_WORKERS;
+static unsigned long jobs_done = 0, jobs_dropped = 0;
+
+static void *worker_main(void *unused) {
+    (void)unused;
+    pthread_mutex_lock(&job_lock);
+    while (true) {
+        while (job_count == 0 && !workers_stopping) {
+            pthread_cond_wait(&job_ready, &job_lock);
+        }
+        if (job_count == 0) {
+            break;
+        }
+        Job job = jobs[job_head];
+        job_head = (job_head + 1) % job_capacity;
+        job_count--;
+        pthread_mutex_unlock(&job_lock);
+
+        if (job.kind == JOB_PRELOAD) {
+            preload_file(job.path, job.offset, job.length);
+        } else {
+            evict_file(job.path, job.offset, job.length);
+        }
+        free(job.path);
+
+        pthread_mutex_lock(&job_lock);
+        jobs_done++;
+    }
+    pthread_mutex_unlock(&job_lock);
+    return NULL;
+}
+
+bool start_workers(void) {
+    jobs = calloc(job_capacity, sizeof(Job));
+    workers = calloc(worker_count, sizeof(pthread_t));
+    if (!jobs || !workers) {
+        perror("calloc");
+        worker_count = 0;  // Nothing for stop_workers to join
+        return false;
+    }
+    for (int i = 0; i < worker_count; i++) {
+        int error = pthread_create(&workers[i], NULL, worker_main, NULL);
+        if (error) {
+            fprintf(stderr, "pthread_create: %s\n", strerror(error));
+            worker_count = i;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Queues a job without waiting; false if the queue was full and the job was dropped
+bool submit_job(JobKind kind, const char *path, off_t offset, off_t length) {
+    char *copy = strdup(path);
+    if (!copy) {
+        perror("strdup");
+        return false;
+    }
+    pthread_mutex_lock(&job_lock);
+    if (job_count == job_capacity) {
+        jobs_dropped++;
+        pthread_mutex_unlock(&job_lock);
+        free(copy);
+        return false;
+    }
+    jobs[(job_head + job_count) % job_capacity] = (Job){kind, copy, offset, length};
+    job_count++;
+    pthread_cond_signal(&job_ready);
+    pthread_mutex_unlock(&job_lock);
+    return true;
+}
+
+// Finishes the queued evictions and stops the workers. Preloads are only hints, so those
+// queued or in progress are cut short.
+void stop_workers(void) {
+    atomic_store(&shutting_down, true);
+    pthread_mutex_lock(&job_lock);
+    workers_stopping = true;
+    pthread_cond_broadcast(&job_ready);
+    pthread_mutex_unlock(&job_lock);
+    for (int i = 0; i < worker_count; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+    free(jobs);
+}
+
+// Watched directories, by watch descriptor. Every directory of the tree is watched, and
+// a directory created or moved into it gets watches for its whole subtree.
+
+typedef struct Watch {
+    int wd;
+    char *path;
+    struct Watch *next;
+} Watch;
+
+static int inotify_fd = -1;
+static Watch **watch_buckets = NULL;
+static size_t watch_bucket_count = 0;   // A power of two
+static size_t watch_count = 0;
+static bool watch_limit_reported = false;
+static unsigned long queue_overflows = 0;
+
+static Watch *find_watch(int wd) {
+    if (!watch_bucket_count) return NULL;
+    for (Watch *watch = watch_buckets[wd & (watch_bucket_count - 1)]; watch; watch = watch->next) {
+        if (watch->wd == wd) return watch;
+    }
+    return NULL;
+}
+
+static bool grow_watch_buckets(void) {
+    size_t count = watch_bucket_count ? watch_bucket_count * 2 : 256;
+    Watch **buckets = calloc(count, sizeof(Watch *));
+    if (!buckets) {
+        perror("calloc");
+        return false;
+    }
+    for (size_t i = 0; i < watch_bucket_count; i++) {
+        Watch *watch = watch_buckets[i];
+        while (watch) {
+            Watch *next = watch->next;
+            watch->next = buckets[watch->wd & (count - 1)];
+            buckets[watch->wd & (count - 1)] = watch;
+            watch = next;
+        }
+    }
+    free(watch_buckets);
+    watch_buckets = buckets;
+    watch_bucket_count = count;
+    return true;
+}
+
+// Watching a directory that is already watched returns its descriptor again, so this
+// also corrects the path of a directory that was moved
+int add_watch(const char *path) {
+    int wd = inotify_add_watch(inotify_fd, path, WATCH_MASK);
+    if (wd < 0) {
+        if (errno == ENOSPC && !watch_limit_reported) {
+            fprintf(stderr, "inotify watch limit reached at %zu directories; raise fs.inotify.max_user_watches\n",
+                    watch_count);
+            watch_limit_reported = true;
+        } else if (errno != ENOENT && errno != ENOSPC) {
+            perror("inotify_add_watch");
+        }
+        return -1;
+    }
+
+    char *copy = strdup(path);
+    if (!copy) {
+        perror("strdup");
+        return wd;
+    }
+    Watch *watch = find_watch(wd);
+    if (watch) {
+        free(watch->path);
+        watch->path = copy;
+        return wd;
+    }
+    if (watch_count >= watch_bucket_count && !grow_watch_buckets()) {
+        free(copy);
+        return wd;
+    }
+    watch = malloc(sizeof(Watch));
+    if (!watch) {
+        perror("malloc");
+        free(copy);
+        return wd;
+    }
+    watch->wd = wd;
+    watch->path = copy;
+    watch->next = watch_buckets[wd & (watch_bucket_count - 1)];
+    watch_buckets[wd & (watch_bucket_count - 1)] = watch;
+    watch_count++;
+    return wd;
+}
+
+static void forget_watch(int wd) {
+    if (!watch_bucket_count) return;
+    Watch **link = &watch_buckets[wd & (watch_bucket_count - 1)];
+    while (*link && (*link)->wd != wd) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        Watch *watch = *link;
+        *link = watch->next;
+        free(watch->path);
+        free(watch);
+        watch_count--;
+    }
+}
+
+static int watch_tree_entry(const char *path, const struct stat *info, int type, struct FTW *position) {
+    (void)info;
+    (void)position;
+    if (type == FTW_D) {
+        add_watch(path);
+    }
+    return 0;
+}
+
+// Watch a directory and every directory below it; false if the top one cannot be watched
+bool add_watch_tree(const char *path) {
+    if (add_watch(path) < 0) {
+        return false;
+    }
+    if (nftw(path, watch_tree_entry, 64, FTW_PHYS) < 0 && errno != ENOENT) {
+        perror("nftw");
+    }
+    return true;
+}
+
+// A directory moved away: stop watching it and its subdirectories. If it moved within the
+// tree, its new location is watched afresh on the IN_MOVED_TO that follows.
+void remove_watch_tree(const char *path) {
+    size_t length = strlen(path);
+    for (size_t i = 0; i < watch_bucket_count; i++) {
+        Watch *watch = watch_buckets[i];
+        while (watch) {
+            Watch *next = watch->next;
+            if (strncmp(watch->path, path, length) == 0 && (watch->path[length] == '\0' || watch->path[length] == '/')) {
+                inotify_rm_watch(inotify_fd, watch->wd);
+                forget_watch(watch->wd);
+            }
+            watch = next;
+        }
+    }
+}
+
+void free_watches(void) {
+    for (size_t i = 0; i < watch_bucket_count; i++) {
+        Watch *watch = watch_buckets[i];
+        while (watch) {
+            Watch *next = watch->next;
+            free(watch->path);
+            free(watch);
+            watch = next;
+        }
+    }
+    free(watch_buckets);
+    watch_buckets = NULL;
+    watch_bucket_count = watch_count = 0;
+}
+
+// Queue a preload of a file's hot ranges if it has any, otherwise of its first warm_limit bytes
+void preload_hot(const char *path) {
+    if (range_bucket_count) {
+        uint64_t hash = hash_path(path);
+        bool listed = false;
+        for (HotRange *range = range_buckets[hash & (range_bucket_count - 1)]; range; range = range->next) {
+            if (range->hash == hash && strcmp(range->path, path) == 0) {
+                submit_job(JOB_PRELOAD, path, range->offset, range->length);
+                listed = true;
+            }
+        }
+        if (listed) return;
+    }
+    submit_job(JOB_PRELOAD, path, 0, warm_limit);
+}
+
+void handle_event(const struct inotify_event *event, const char *root) {
+    if (event->mask & IN_Q_OVERFLOW) {
+        // Events were lost, including perhaps new directories: watch anything missed
+        queue_overflows++;
+        fprintf(stderr, "inotify queue overflowed; rescanning %s\n", root);
+        add_watch_tree(root);
+        return;
+    }
+    if (event->mask & IN_IGNORED) {
+        forget_watch(event->wd);
+        return;
+    }
+    Watch *watch = find_watch(event->wd);
+    if (!watch || !event->len) {
         return;
     }
 
-    struct stat file_stat;
-    if (fstat(fd, &file_stat) < 0) {
-        perror("fstat");
-        close(fd);
+    char full_path[PATH_MAX];
+    if (snprintf(full_path, PATH_MAX, "%s/%s", watch->path, event->name) >= PATH_MAX) {
         return;
     }
+    if (verbose) {
+        printf("[DEBUG] Event detected: %s (mask: 0x%x)\n", full_path, event->mask);
+    }
 
-    void *map = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    if (map == MAP_FAILED) {
-        perror("mmap");
-        close(fd);
+    if (event->mask & IN_ISDIR) {
+        if (event->mask & IN_MOVED_FROM) {
+            remove_watch_tree(full_path);
+        }
+        if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+            add_watch_tree(full_path);
+        }
         return;
     }
 
-    if (madvise(map, file_stat.st_size, MADV_DONTNEED) < 0) {
-        perror("madvise");
-    } else {
-        printf("Evicted file from cache: %s (size: %ld bytes)\n", filename, file_stat.st_size);
+    if (event->mask & IN_ACCESS) {
+        if (should_process_event(full_path)) {
+            printf("File accessed: %s\n", full_path);
+            preload_hot(full_path);
+        }
     }
 
-    munmap(map, file_stat.st_size);
-    close(fd);
+    if (event->mask & IN_MODIFY) {
+        if (should_process_event(full_path)) {
+            printf("File modified: %s\n", full_path);
+            submit_job(JOB_EVICT, full_path, 0, 0);
+        }
+    }
+}
+
+// Handles every queued event; false on a read error
+bool drain_events(const char *root) {
+    char buffer[EVENT_BUF_LEN] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (true) {
+        ssize_t length = read(inotify_fd, buffer, EVENT_BUF_LEN);
+        if (length < 0) {
+            if (errno == EAGAIN || errno == EINTR) {
+                return true;
+            }
+            perror("read");
+            return false;
+        }
+        for (ssize_t i = 0; i < length;) {
+            struct inotify_event *event = (struct inotify_event *)&buffer[i];
+            handle_event(event, root);
+            i += sizeof(struct inotify_event) + event->len;
+        }
+    }
 }
 
+// Runs until SIGINT or SIGTERM. The event loop waits on inotify and on the signals
+// through epoll, waking at least once per cooldown to expire cooldown entries.
 void monitor_directory(const char *path) {
-    int fd = inotify_init();
-    if (fd < 0) {
-        perror("inotify_init");
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);   // Before the workers start, so they inherit it
+    int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd < 0) {
+        perror("signalfd");
         exit(EXIT_FAILURE);
     }
 
-    int wd = inotify_add_watch(fd, path, IN_ACCESS | IN_MODIFY | IN_OPEN);
-    if (wd == -1) {
-        perror("inotify_add_watch");
-        close(fd);
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        perror("inotify_init1");
+        exit(EXIT_FAILURE);
+    }
+    if (!add_watch_tree(path)) {
+        close(inotify_fd);
         exit(EXIT_FAILURE);
     }
 
-    printf("Monitoring file access and modifications in directory: %s\n", path);
-
-    char buffer[EVENT_BUF_LEN];
-    while (1) {
-        int length = read(fd, buffer, EVENT_BUF_LEN);
-        if (length < 0) {
-            perror("read");
-            break;
-        }
-
-        int i = 0;
-        while (i < length) {
-            struct inotify_event *event = (struct inotify_event *)&buffer[i];
-            if (event->len) {
-                char full_path[PATH_MAX];
-                snprintf(full_path, PATH_MAX, "%s/%s", path, event->name);
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event interest = {.events = EPOLLIN};
+    interest.data.fd = inotify_fd;
+    if (epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, inotify_fd, &interest) < 0) {
+        perror("epoll");
+        exit(EXIT_FAILURE);
+    }
+    interest.data.fd = signal_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &interest) < 0) {
+        perror("epoll_ctl");
+        exit(EXIT_FAILURE);
+    }
 
-                printf("[DEBUG] Event detected: %s (mask: 0x%x)\n", full_path, event->mask);
+    if (!start_workers()) {
+        stop_workers();
+        exit(EXIT_FAILURE);
+    }
 
-                if (event->mask & IN_ACCESS) {
-                    if (should_process_event(full_path)) {
-                        printf("File accessed: %s\n", full_path);
-                        preload_file(full_path);
-                    }
-                }
+    printf("Monitoring file access and modifications under: %s (%zu directories, %d workers)\n", path, watch_count,
+           worker_count);
 
-                if (event->mask & IN_MODIFY) {
-                    if (should_process_event(full_path)) {
-                        printf("File modified: %s\n", full_path);
-                        evict_file(full_path);
-                    }
-                }
+    bool running = true;
+    while (running) {
+        struct epoll_event ready[2];
+        int count = epoll_wait(epoll_fd, ready, 2, (int)cooldown_ms);
+        if (count < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            if (ready[i].data.fd == signal_fd) {
+                running = false;
+            } else if (!drain_events(path)) {
+                running = false;
             }
-            i += EVENT_SIZE + event->len;
         }
+        expire_events();
     }
 
-    inotify_rm_watch(fd, wd);
-    close(fd);
+    printf("Stopping: %zu jobs queued; evictions finish, preloads are cut short\n", job_count);
+    stop_workers();
+    printf("Jobs done: %lu | Dropped (queue full): %lu | Queue overflows: %lu | Directories watched: %zu\n",
+           jobs_done, jobs_dropped, queue_overflows, watch_count);
+
+    free_watches();
+    free_events();
+    free_hot_ranges();
+    close(epoll_fd);
+    close(inotify_fd);
+    close(signal_fd);
+}
+
+// A byte count with an optional K, M or G suffix; -1 if malformed
+static long long parse_size(const char *text) {
+    char *end;
+    long long value = strtoll(text, &end, 10);
+    if (end == text || value < 0) return -1;
+    switch (*end) {
+    case 'G': case 'g': value <<= 10; /* fall through */
+    case 'M': case 'm': value <<= 10; /* fall through */
+    case 'K': case 'k': value <<= 10; end++; break;
+    }
+    return *end ? -1 : value;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <directory_to_monitor>\n", argv[0]);
+    const char *ranges_path = NULL;
+    long long size;
+    int option;
+    while ((option = getopt(argc, argv, "c:w:q:b:r:l:R:v")) != -1) {
+        switch (option) {
+        case 'c':
+            cooldown_ms = strtoull(optarg, NULL, 10) * 1000;
+            break;
+        case 'w':
+            worker_count = atoi(optarg);
+            break;
+        case 'q':
+            job_capacity = strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            chunk_bytes = (size = parse_size(optarg)) > 0 ? size : -1;
+            break;
+        case 'r':
+            rate_limit_bytes = (size = parse_size(optarg)) >= 0 ? size : -1;
+            break;
+        case 'l':
+            warm_limit = (size = parse_size(optarg)) >= 0 ? size : -1;
+            break;
+        case 'R':
+            ranges_path = optarg;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            optind = argc + 1;
+        }
+    }
+    if (optind != argc - 1 || worker_count < 1 || worker_count > MAX_WORKERS || job_capacity < 1 ||
+        job_capacity > MAX_QUEUE_LENGTH || cooldown_ms < 1 || chunk_bytes < 1 || rate_limit_bytes < 0 || warm_limit < 0) {
+        fprintf(stderr,
+                "Usage: %s [-c cooldown_seconds] [-w workers] [-q queue_length] [-b chunk_bytes] [-r bytes_per_second]\n"
+                "          [-l warm_limit_bytes] [-R hot_ranges_file] [-v] <directory_to_monitor>\n"
+                "Defaults: %d second cooldown, %d workers (at most %d), %d queued jobs (at most %d), 4M chunks,\n"
+                "no rate limit, whole files.\n"
+                "Sizes take a K, M or G suffix. Each line of the hot ranges file is \"offset length path\";\n"
+                "a listed file only has those ranges preloaded. -v logs every event.\n",
+                argv[0], DEFAULT_COOLDOWN_SECONDS, DEFAULT_WORKERS, MAX_WORKERS, DEFAULT_QUEUE_LENGTH,
+                MAX_QUEUE_LENGTH);
+        exit(EXIT_FAILURE);
+    }
+    if (ranges_path && !load_hot_ranges(ranges_path)) {
         exit(EXIT_FAILURE);
     }
 
-    monitor_directory(argv[1]);
+    monitor_directory(argv[optind]);
     return 0;
 }
@@ -6,7 +6,7 @@ class File {
 public:
     string name;
     string content;
-    int size;
+    size_t size;
 
     File(string name = "", string content = "") : name(name), content(content), size(content.size()) {}
 };
@@ -72,26 +72,114 @@ public:
 };
 
 // Class representing the Cache with LFU eviction policy
+// Capacity is a byte budget: each entry is charged its content size, and files larger
+// than maxObjectFraction of the budget are not admitted so one file cannot flush the cache.
 class Cache {
 private:
-    int capacity;
-    int currentSize;
+    size_t capacity;      // Byte budget
+    size_t currentSize;   // Bytes currently cached
+    size_t maxObjectSize; // Largest file admitted, capacity * maxObjectFraction
+
+    // Frequency bucket: the names of all entries accessed `frequency` times,
+    // most recently used at the front
+    struct FrequencyNode {
+        int frequency;
+        list<string> names;
+    };
 
     // Structure to hold cache entries
     struct CacheEntry {
         File file;
         int frequency;
-        int timestamp; // To resolve ties in frequency
+        list<FrequencyNode>::iterator node;  // Bucket for this entry's frequency
+        list<string>::iterator position;     // Position inside node->names
     };
 
     unordered_map<string, CacheEntry> cacheMap;
-    // Min-heap to determine which file to evict
-    // Pair of (frequency, timestamp) and file name
-    priority_queue<pair<pair<int, int>, string>, vector<pair<pair<int, int>, string>>, std::greater<pair<pair<int, int>, string>>> minHeap;
-    int globalTimestamp;
+
+    // Buckets in ascending frequency order, only non-empty ones are kept. The eviction
+    // victim is the back (least recent) of the first bucket, which is the same
+    // (frequency, last access) order the old min-heap used, but every operation is O(1)
+    // and memory stays proportional to the number of cached entries.
+    list<FrequencyNode> frequencies;
+
+    // Add a new entry at the front of the frequency-1 bucket
+    void linkEntry(const string& name, CacheEntry& entry) {
+        if (frequencies.empty() || frequencies.front().frequency != 1) {
+            frequencies.push_front({1, {}});
+        }
+        entry.frequency = 1;
+        entry.node = frequencies.begin();
+        entry.node->names.push_front(name);
+        entry.position = entry.node->names.begin();
+    }
+
+    // Move an entry into the bucket for frequency + 1, creating it if needed
+    void touch(CacheEntry& entry) {
+        auto current = entry.node;
+        auto next = std::next(current);
+        if (next == frequencies.end() || next->frequency != current->frequency + 1) {
+            next = frequencies.insert(next, {current->frequency + 1, {}});
+        }
+        // splice relinks the list node, so entry.position stays valid
+        next->names.splice(next->names.begin(), current->names, entry.position);
+        if (current->names.empty()) {
+            frequencies.erase(current);
+        }
+        entry.node = next;
+        entry.frequency++;
+    }
+
+    void unlinkEntry(CacheEntry& entry) {
+        entry.node->names.erase(entry.position);
+        if (entry.node->names.empty()) {
+            frequencies.erase(entry.node);
+        }
+    }
+
+    // Next eviction victim other than `keep`, or nullptr if there is none.
+    // `keep` can only shadow one candidate, so this looks at most two names.
+    const string* victimExcluding(const string& keep) const {
+        for (const auto& node : frequencies) {
+            for (auto it = node.names.rbegin(); it != node.names.rend(); ++it) {
+                if (*it != keep) return &*it;
+            }
+        }
+        return nullptr;
+    }
+
+    // Evict least frequently used entries until `incoming` more bytes fit in the budget.
+    // The entry named `keep` (if any) is never chosen, so an update cannot evict itself.
+    void evictUntilFits(size_t incoming, const string& keep = "") {
+        while (currentSize + incoming > capacity) {
+            const string* victim = victimExcluding(keep);
+            if (!victim) break;
+            string evictName = *victim;
+            auto it = cacheMap.find(evictName);
+            currentSize -= it->second.file.size;
+            unlinkEntry(it->second);
+            cacheMap.erase(it);
+            cout << "Evicted file '" << evictName << "' from cache.\n";
+        }
+    }
 
 public:
-    Cache(int capacity) : capacity(capacity), currentSize(0), globalTimestamp(0) {}
+    Cache(size_t capacity, double maxObjectFraction = 0.5)
+        : capacity(capacity), currentSize(0),
+          maxObjectSize(static_cast<size_t>(capacity * maxObjectFraction)) {}
+
+    // Files above the size limit are served from the filesystem but never cached
+    bool admits(const File& file) const {
+        return file.size <= maxObjectSize;
+    }
+
+    size_t usedBytes() const {
+        return currentSize;
+    }
+
+    size_t capacityBytes() const {
+        return capacity;
+    }
 
     bool isCached(const string& name) {
         return cacheMap.find(name) != cacheMap.end();
@@ -99,12 +187,11 @@ public:
 
     // Get a file from cache
     File get(const string& name) {
-        if (isCached(name)) {
-            cacheMap[name].frequency += 1;
-            cacheMap[name].timestamp = globalTimestamp++;
-            minHeap.push({{cacheMap[name].frequency, cacheMap[name].timestamp}, name});
+        auto it = cacheMap.find(name);
+        if (it != cacheMap.end()) {
+            touch(it->second);
             cout << "Cache hit for file '" << name << "'.\n";
-            return cacheMap[name].file;
+            return it->second.file;
         } else {
             cout << "Cache miss for file '" << name << "'.\n";
             // Return an empty file if not in cache
@@ -116,51 +203,49 @@ public:
     void put(const File& file) {
         if (capacity == 0) return;
 
-        if (isCached(file.name)) {
+        auto existing = cacheMap.find(file.name);
+        if (existing != cacheMap.end()) {
+            currentSize -= existing->second.file.size;
+            if (!admits(file)) {
+                // The new content is too large to keep cached
+                unlinkEntry(existing->second);
+                cacheMap.erase(existing);
+                cout << "File '" << file.name << "' grew past the admission limit; removed from cache.\n";
+                return;
+            }
             // Update the file content and frequency
-            cacheMap[file.name].file = file;
-            cacheMap[file.name].frequency += 1;
-            cacheMap[file.name].timestamp = globalTimestamp++;
-            minHeap.push({{cacheMap[file.name].frequency, cacheMap[file.name].timestamp}, file.name});
+            existing->second.file = file;
+            touch(existing->second);
+            currentSize += file.size;
+            // A larger version may push the cache over budget
+            evictUntilFits(0, file.name);
             cout << "File '" << file.name << "' updated in cache.\n";
             return;
         }
 
-        if (currentSize >= capacity) {
-            // Evict the least frequently used file
-            while (!minHeap.empty()) {
-                auto top = minHeap.top();
-                minHeap.pop();
-                string evictName = top.second;
-                // Check if this entry is the current one
-                if (cacheMap.find(evictName) != cacheMap.end() &&
-                    cacheMap[evictName].frequency == top.first.first &&
-                    cacheMap[evictName].timestamp == top.first.second) {
-                    // Evict this file
-                    cacheMap.erase(evictName);
-                    currentSize--;
-                    cout << "Evicted file '" << evictName << "' from cache.\n";
-                    break;
-                }
-            }
+        if (!admits(file)) {
+            cout << "File '" << file.name << "' (" << file.size << " bytes) exceeds the admission limit of "
+                 << maxObjectSize << " bytes; not cached.\n";
+            return;
         }
 
+        // Evict least frequently used files until the new one fits
+        evictUntilFits(file.size);
+
         // Add the new file to cache
-        CacheEntry entry;
+        CacheEntry& entry = cacheMap[file.name];
         entry.file = file;
-        entry.frequency = 1;
-        entry.timestamp = globalTimestamp++;
-        cacheMap[file.name] = entry;
-        minHeap.push({{entry.frequency, entry.timestamp}, file.name});
-        currentSize++;
+        linkEntry(file.name, entry);
+        currentSize += file.size;
         cout << "File '" << file.name << "' added to cache.\n";
     }
 
     // Display cache contents
     void displayCache() {
-        cout << "Current Cache Contents:\n";
+        cout << "Current Cache Contents (" << currentSize << " / " << capacity << " bytes):\n";
         for (const auto& pair : cacheMap) {
-            cout << " - " << pair.first << " (Freq: " << pair.second.frequency << ")\n";
+            cout << " - " << pair.first << " (Freq: " << pair.second.frequency
+                 << ", Size: " << pair.second.file.size << " bytes)\n";
         }
     }
 };
@@ -207,7 +292,8 @@ private:
     CacheOptimizer optimizer;
 
 public:
-    FileSystemCacheOptimizer(int cacheCapacity) : cache(cacheCapacity) {}
+    FileSystemCacheOptimizer(size_t cacheCapacityBytes, double maxObjectFraction = 0.5)
+        : cache(cacheCapacityBytes, maxObjectFraction) {}
 
     // Add a file to the filesystem
     void addFile(const string& name, const string& content) {
@@ -269,8 +355,8 @@ public:
 
 // Main function to demonstrate the filesystem with cache optimizer
 int main() {
-    // Initialize FileSystemCacheOptimizer with cache capacity of 3 files
-    FileSystemCacheOptimizer fsCacheOpt(3);
+    // Initialize FileSystemCacheOptimizer with a 90 byte budget (about three of the files below)
+    FileSystemCacheOptimizer fsCacheOpt(90);
 
     // Add files to the filesystem
     fsCacheOpt.addFile("file1.txt", "This is the content of file1.");
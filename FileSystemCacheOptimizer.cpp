@@ -1,27 +1,56 @@
 #include <bits/stdc++.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <malloc.h>
+#include "GhostList.h"
+#include "LatencyHistogram.h"
+#include "MemoryGovernor.h"
+#include "SlabAllocator.h"
 using namespace std;
 
 // Structure to hold performance metrics
 struct PerformanceMetrics {
+    // Operation types with their own latency histogram
+    enum Operation { Hit, Miss, Write, Eviction, OperationCount };
+
     int totalAccesses;
     int cacheHits;
     int cacheMisses;
     double hitRatio;
     double missRatio;
-    double totalAccessTime; // in milliseconds
+    double totalAccessTime; // in microseconds
+    LatencyHistogram latencies[OperationCount]; // Measured nanoseconds per operation type
 
     PerformanceMetrics() : totalAccesses(0), cacheHits(0), cacheMisses(0), hitRatio(0.0), missRatio(0.0), totalAccessTime(0.0) {}
 
-    void updateMetrics(bool hit, double accessTime) {
+    // Counts an access and records its measured latency under op
+    void updateMetrics(bool hit, Operation op, uint64_t nanos) {
         totalAccesses++;
         if (hit) cacheHits++;
         else cacheMisses++;
-        totalAccessTime += accessTime;
+        totalAccessTime += nanos / 1e3;
+        hitRatio = (totalAccesses > 0) ? ((double)cacheHits / totalAccesses) * 100.0 : 0.0;
+        missRatio = (totalAccesses > 0) ? ((double)cacheMisses / totalAccesses) * 100.0 : 0.0;
+        latencies[op].record(nanos);
+    }
+
+    // Adds another thread's (or component's) metrics into this one
+    void merge(const PerformanceMetrics& other) {
+        totalAccesses += other.totalAccesses;
+        cacheHits += other.cacheHits;
+        cacheMisses += other.cacheMisses;
+        totalAccessTime += other.totalAccessTime;
         hitRatio = (totalAccesses > 0) ? ((double)cacheHits / totalAccesses) * 100.0 : 0.0;
         missRatio = (totalAccesses > 0) ? ((double)cacheMisses / totalAccesses) * 100.0 : 0.0;
+        for (int op = 0; op < OperationCount; ++op) {
+            latencies[op].merge(other.latencies[op]);
+        }
     }
 
     void display() const {
+        static const char* names[OperationCount] = {"Hit", "Miss", "Write", "Eviction"};
         cout << fixed << setprecision(2);
         cout << "\n--- Performance Metrics ---\n";
         cout << "Total Accesses : " << totalAccesses << endl;
@@ -29,9 +58,17 @@ struct PerformanceMetrics {
         cout << "Cache Misses   : " << cacheMisses << endl;
         cout << "Hit Ratio      : " << hitRatio << " %" << endl;
         cout << "Miss Ratio     : " << missRatio << " %" << endl;
-        cout << "Total Access Time: " << totalAccessTime << " ms" << endl;
+        cout << "Total Access Time: " << totalAccessTime << " us" << endl;
         if (totalAccesses > 0) {
-            cout << "Average Access Time: " << (totalAccessTime / totalAccesses) << " ms" << endl;
+            cout << "Average Access Time: " << (totalAccessTime / totalAccesses) << " us" << endl;
+        }
+        cout << "Latency (ns)      count       p50       p90       p99      p999       max\n";
+        for (int op = 0; op < OperationCount; ++op) {
+            const LatencyHistogram& h = latencies[op];
+            cout << left << setw(12) << names[op] << right << setw(11) << h.count()
+                 << setw(10) << h.percentile(0.50) << setw(10) << h.percentile(0.90)
+                 << setw(10) << h.percentile(0.99) << setw(10) << h.percentile(0.999)
+                 << setw(10) << h.max() << endl;
         }
         cout << "----------------------------\n";
     }
@@ -42,19 +79,34 @@ class File {
 public:
     string name;
     string content;
-    int size;
+    size_t size;
 
-    File(string name = "", string content = "") : name(name), content(content), size(content.size()) {}
+    File(string name = "", string content = "") : name(std::move(name)), content(std::move(content)), size(this->content.size()) {}
 };
 
-// Class representing the filesystem
-class FileSystem {
+// Backing store that the cache sits in front of. Implementations must allow concurrent calls.
+class StorageBackend {
+public:
+    virtual ~StorageBackend() {}
+    virtual void addFile(const string& name, const string& content) = 0;
+    virtual string readFile(const string& name) = 0;
+    // Up to `length` bytes from `offset`; shorter at the end of the file, empty past it
+    virtual string readRange(const string& name, size_t offset, size_t length) = 0;
+    virtual void writeFile(const string& name, const string& content) = 0;
+    virtual void listFiles() const = 0;
+    virtual vector<string> getAllFileNames() const = 0;
+};
+
+// Class representing the filesystem (in memory, used for tests and demos)
+class FileSystem : public StorageBackend {
 private:
     unordered_map<string, File> files;
+    mutable shared_mutex lock;
 
 public:
     // Add a new file to the filesystem
-    void addFile(const string& name, const string& content) {
+    void addFile(const string& name, const string& content) override {
+        unique_lock<shared_mutex> guard(lock);
         if (files.find(name) != files.end()) {
             cout << "File '" << name << "' already exists. Overwriting content.\n";
             files[name].content = content;
@@ -66,31 +118,47 @@ public:
     }
 
     // Read a file's content
-    string readFile(const string& name) {
-        if (files.find(name) != files.end()) {
+    string readFile(const string& name) override {
+        shared_lock<shared_mutex> guard(lock);
+        auto it = files.find(name);
+        if (it != files.end()) {
             // Simulate disk I/O delay (e.g., 100 ms for disk access)
            // this_thread::sleep_for(chrono::milliseconds(100));
-            return files[name].content;
+            return it->second.content;
         } else {
             cout << "File '" << name << "' not found in filesystem.\n";
             return "";
         }
     }
 
+    string readRange(const string& name, size_t offset, size_t length) override {
+        shared_lock<shared_mutex> guard(lock);
+        auto it = files.find(name);
+        if (it == files.end()) {
+            cout << "File '" << name << "' not found in filesystem.\n";
+            return "";
+        }
+        const string& content = it->second.content;
+        return offset < content.size() ? content.substr(offset, length) : "";
+    }
+
     // Write content to a file
-    void writeFile(const string& name, const string& content) {
+    void writeFile(const string& name, const string& content) override {
+        unique_lock<shared_mutex> guard(lock);
         if (files.find(name) != files.end()) {
             files[name].content = content;
             files[name].size = content.size();
             cout << "File '" << name << "' updated in filesystem.\n";
         } else {
             cout << "File '" << name << "' does not exist. Creating new file.\n";
+            guard.unlock();
             addFile(name, content);
         }
     }
 
     // List all files in the filesystem
-    void listFiles() const {
+    void listFiles() const override {
+        shared_lock<shared_mutex> guard(lock);
         cout << "Files in filesystem:\n";
         for (const auto& pair : files) {
             cout << " - " << pair.first << " (Size: " << pair.second.size << " bytes)\n";
@@ -98,7 +166,8 @@ public:
     }
 
     // Get all file names
-    vector<string> getAllFileNames() const {
+    vector<string> getAllFileNames() const override {
+        shared_lock<shared_mutex> guard(lock);
         vector<string> names;
         for (const auto& pair : files) {
             names.push_back(pair.first);
@@ -107,100 +176,1057 @@ public:
     }
 };
 
+// Filesystem backed by real files under a root directory, accessed with pread/pwrite.
+// With directIO the files are opened O_DIRECT so reads bypass the kernel page cache and
+// the user-space cache is measured against the device, not against another cache.
+// I/O goes through a reusable aligned buffer per thread, so concurrent calls are safe.
+class PosixFileSystem : public StorageBackend {
+private:
+    struct FreeDeleter {
+        void operator()(char* p) const { free(p); }
+    };
+
+    static constexpr size_t alignment = 4096;  // Satisfies O_DIRECT on common block devices
+    string root;
+    atomic<bool> directIO;
+
+    static size_t roundUp(size_t bytes) {
+        return (bytes + alignment - 1) / alignment * alignment;
+    }
+
+    string pathFor(const string& name) const {
+        return root + "/" + name;
+    }
+
+    // Names are plain file names inside root
+    bool validName(const string& name) const {
+        return !name.empty() && name.find('/') == string::npos && name != "." && name != "..";
+    }
+
+    // Aligned scratch buffer of at least `bytes`, reused between calls on the same thread
+    static char* reserve(size_t bytes) {
+        static thread_local unique_ptr<char, FreeDeleter> buffer;
+        static thread_local size_t bufferSize = 0;
+        bytes = max(roundUp(bytes), alignment);
+        if (bytes > bufferSize) {
+            void* memory = nullptr;
+            if (posix_memalign(&memory, alignment, bytes) != 0) {
+                throw bad_alloc();
+            }
+            buffer.reset(static_cast<char*>(memory));
+            bufferSize = bytes;
+        }
+        return buffer.get();
+    }
+
+    // Opens with O_DIRECT when enabled; filesystems that reject it (e.g. tmpfs) fall back to buffered I/O
+    int openFile(const string& path, int flags) {
+        if (directIO) {
+            int fd = open(path.c_str(), flags | O_DIRECT, 0644);
+            if (fd >= 0 || errno != EINVAL) {
+                return fd;
+            }
+            if (directIO.exchange(false)) {
+                cerr << "O_DIRECT not supported under '" << root << "'; using buffered I/O.\n";
+            }
+        }
+        return open(path.c_str(), flags, 0644);
+    }
+
+    // Descriptor for reading an existing file, or -1 after reporting why not
+    int openForRead(const string& name) {
+        if (!validName(name)) {
+            cout << "File '" << name << "' not found in filesystem.\n";
+            return -1;
+        }
+        int fd = openFile(pathFor(name), O_RDONLY);
+        if (fd < 0) {
+            if (errno == ENOENT) {
+                cout << "File '" << name << "' not found in filesystem.\n";
+            } else {
+                cerr << "open '" << name << "': " << strerror(errno) << "\n";
+            }
+        }
+        return fd;
+    }
+
+    // Reads from `offset` in transfers of up to `length` bytes until `wanted` bytes have
+    // arrived or the file ends. Bytes read, or -1 on error.
+    static ssize_t readAt(int fd, const string& name, char* data, size_t length, size_t offset, size_t wanted) {
+        size_t done = 0;
+        while (done < wanted) {
+            ssize_t n = pread(fd, data + done, length - done, offset + done);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                cerr << "pread '" << name << "': " << strerror(errno) << "\n";
+                return -1;
+            }
+            if (n == 0) break;
+            done += n;
+        }
+        return done;
+    }
+
+public:
+    PosixFileSystem(const string& rootDirectory, bool directIO = false)
+        : root(rootDirectory), directIO(directIO) {
+        if (mkdir(root.c_str(), 0755) < 0 && errno != EEXIST) {
+            throw runtime_error("cannot create '" + root + "': " + strerror(errno));
+        }
+    }
+
+    bool usesDirectIO() const {
+        return directIO;
+    }
+
+    void addFile(const string& name, const string& content) override {
+        if (access(pathFor(name).c_str(), F_OK) == 0) {
+            cout << "File '" << name << "' already exists. Overwriting content.\n";
+        } else {
+            cout << "File '" << name << "' added to filesystem.\n";
+        }
+        store(name, content);
+    }
+
+    string readFile(const string& name) override {
+        int fd = openForRead(name);
+        if (fd < 0) return "";
+
+        struct stat info;
+        if (fstat(fd, &info) < 0) {
+            cerr << "fstat '" << name << "': " << strerror(errno) << "\n";
+            close(fd);
+            return "";
+        }
+        size_t size = info.st_size;
+        // O_DIRECT transfers must cover whole blocks, so ask for the rounded-up length
+        size_t length = directIO ? roundUp(size) : size;
+        char* data = reserve(length);
+
+        ssize_t done = readAt(fd, name, data, length, 0, size);
+        close(fd);
+        return done < 0 ? "" : string(data, min(static_cast<size_t>(done), size));
+    }
+
+    string readRange(const string& name, size_t offset, size_t length) override {
+        int fd = openForRead(name);
+        if (fd < 0) return "";
+
+        // O_DIRECT transfers must start and end on block boundaries, so read the aligned
+        // span around the range and copy the range out of it
+        size_t start = directIO ? offset / alignment * alignment : offset;
+        size_t span = directIO ? roundUp(offset + length) - start : length;
+        char* data = reserve(span);
+
+        ssize_t done = readAt(fd, name, data, span, start, span);
+        close(fd);
+        size_t skip = offset - start;
+        if (done < 0 || static_cast<size_t>(done) <= skip) return "";
+        return string(data + skip, min(static_cast<size_t>(done) - skip, length));
+    }
+
+    void writeFile(const string& name, const string& content) override {
+        if (access(pathFor(name).c_str(), F_OK) == 0) {
+            cout << "File '" << name << "' updated in filesystem.\n";
+        } else {
+            cout << "File '" << name << "' does not exist. Creating new file.\n";
+        }
+        store(name, content);
+    }
+
+    void listFiles() const override {
+        cout << "Files in filesystem:\n";
+        for (const string& name : getAllFileNames()) {
+            struct stat info;
+            if (stat(pathFor(name).c_str(), &info) == 0) {
+                cout << " - " << name << " (Size: " << info.st_size << " bytes)\n";
+            }
+        }
+    }
+
+    vector<string> getAllFileNames() const override {
+        vector<string> names;
+        DIR* dir = opendir(root.c_str());
+        if (!dir) return names;
+        while (dirent* entry = readdir(dir)) {
+            string name = entry->d_name;
+            struct stat info;
+            if (validName(name) && stat(pathFor(name).c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+                names.push_back(name);
+            }
+        }
+        closedir(dir);
+        return names;
+    }
+
+private:
+    void store(const string& name, const string& content) {
+        if (!validName(name)) {
+            cerr << "Invalid file name '" << name << "'.\n";
+            return;
+        }
+        int fd = openFile(pathFor(name), O_WRONLY | O_CREAT | O_TRUNC);
+        if (fd < 0) {
+            cerr << "open '" << name << "': " << strerror(errno) << "\n";
+            return;
+        }
+
+        // O_DIRECT needs an aligned source and whole blocks; the padding is truncated away after
+        const char* data = content.data();
+        size_t length = content.size();
+        if (directIO) {
+            length = roundUp(content.size());
+            char* aligned = reserve(length);
+            memcpy(aligned, content.data(), content.size());
+            memset(aligned + content.size(), 0, length - content.size());
+            data = aligned;
+        }
+
+        size_t done = 0;
+        while (done < length) {
+            ssize_t n = pwrite(fd, data + done, length - done, done);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                cerr << "pwrite '" << name << "': " << strerror(errno) << "\n";
+                break;
+            }
+            done += n;
+        }
+        if (length != content.size() && ftruncate(fd, content.size()) < 0) {
+            cerr << "ftruncate '" << name << "': " << strerror(errno) << "\n";
+        }
+        close(fd);
+    }
+};
+
+// Count-min sketch of recent access frequencies, used by the TinyLFU admission filter.
+// Four rows of 4-bit counters packed 16 per word; an estimate is the minimum over the rows.
+// After sampleSize recorded accesses every counter is halved, so old popularity fades.
+// The optional doorkeeper is a small bloom filter that absorbs the first access of each
+// key, so one-hit wonders never reach (and pollute) the counters.
+class FrequencySketch {
+private:
+    static const int depth = 4;
+    vector<uint64_t> table;       // depth rows of (width / 16) words
+    vector<uint64_t> doorkeeper;  // Bloom filter bits, empty when disabled
+    size_t width;                 // Counters per row, a power of two
+    size_t sampleSize;
+    size_t additions;
+
+    static uint64_t mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // Counter index of `hash` in row i, via double hashing
+    size_t indexOf(uint64_t hash, int i) const {
+        uint64_t h = hash + i * (mix(hash) | 1);
+        return i * width + (h & (width - 1));
+    }
+
+    int counterAt(size_t index) const {
+        return (table[index >> 4] >> ((index & 15) << 2)) & 0xF;
+    }
+
+    bool doorkeeperContains(uint64_t hash) const {
+        size_t bits = doorkeeper.size() * 64;
+        uint64_t h2 = mix(hash);
+        size_t a = hash % bits, b = h2 % bits;
+        return (doorkeeper[a >> 6] >> (a & 63) & 1) && (doorkeeper[b >> 6] >> (b & 63) & 1);
+    }
+
+    void doorkeeperAdd(uint64_t hash) {
+        size_t bits = doorkeeper.size() * 64;
+        uint64_t h2 = mix(hash);
+        size_t a = hash % bits, b = h2 % bits;
+        doorkeeper[a >> 6] |= uint64_t(1) << (a & 63);
+        doorkeeper[b >> 6] |= uint64_t(1) << (b & 63);
+    }
+
+    // Halve every counter and clear the doorkeeper
+    void reset() {
+        for (auto& word : table) {
+            word = (word >> 1) & 0x7777777777777777ULL;
+        }
+        fill(doorkeeper.begin(), doorkeeper.end(), 0);
+        additions /= 2;
+    }
+
+public:
+    FrequencySketch(size_t expectedEntries, bool useDoorkeeper) : width(16), additions(0) {
+        while (width < expectedEntries) width <<= 1;
+        table.assign(depth * width / 16, 0);
+        if (useDoorkeeper) {
+            doorkeeper.assign(width / 8, 0);  // 8 bits per expected entry
+        }
+        sampleSize = 10 * width;
+    }
+
+    void increment(const string& key) {
+        uint64_t hash = mix(std::hash<string>{}(key));
+        if (!doorkeeper.empty() && !doorkeeperContains(hash)) {
+            doorkeeperAdd(hash);
+        } else {
+            // Conservative update: only the counters at the current minimum are raised
+            int minimum = 15;
+            for (int i = 0; i < depth; ++i) minimum = min(minimum, counterAt(indexOf(hash, i)));
+            if (minimum < 15) {
+                for (int i = 0; i < depth; ++i) {
+                    size_t index = indexOf(hash, i);
+                    if (counterAt(index) == minimum) {
+                        table[index >> 4] += uint64_t(1) << ((index & 15) << 2);
+                    }
+                }
+            }
+        }
+        if (++additions >= sampleSize) {
+            reset();
+        }
+    }
+
+    int estimate(const string& key) const {
+        uint64_t hash = mix(std::hash<string>{}(key));
+        int minimum = 15;
+        for (int i = 0; i < depth; ++i) minimum = min(minimum, counterAt(indexOf(hash, i)));
+        if (!doorkeeper.empty() && doorkeeperContains(hash)) {
+            minimum++;
+        }
+        return minimum;
+    }
+
+    size_t memoryBytes() const {
+        return (table.size() + doorkeeper.size()) * sizeof(uint64_t);
+    }
+};
+
+// Read-only, reference-counted view of cached file content. A handle keeps its bytes
+// alive, so they stay valid after the entry is evicted or overwritten and are freed only
+// when the last handle is dropped. Copying a handle never copies the content.
+class FileHandle {
+private:
+    shared_ptr<const char> bytes;
+    size_t length = 0;
+
+public:
+    FileHandle() {}
+
+    // Content kept in its own heap string
+    explicit FileHandle(string content) {
+        auto owner = make_shared<const string>(std::move(content));
+        bytes = shared_ptr<const char>(owner, owner->data());
+        length = owner->size();
+    }
+
+    // Content copied into a slab chunk, which goes back to the allocator when the last
+    // handle drops. Invalid if the allocator has no room for it.
+    static FileHandle inSlab(const shared_ptr<SlabAllocator>& slabs, string_view content) {
+        FileHandle handle;
+        size_t size = content.size();
+        char* chunk = static_cast<char*>(slabs->allocate(size));
+        if (!chunk) return handle;
+        memcpy(chunk, content.data(), size);
+        handle.bytes = shared_ptr<const char>(chunk, [slabs, size](const char* p) {
+            slabs->deallocate(const_cast<char*>(p), size);
+        });
+        handle.length = size;
+        return handle;
+    }
+
+    bool valid() const {
+        return bytes != nullptr;
+    }
+
+    string_view view() const {
+        return bytes ? string_view(bytes.get(), length) : string_view();
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    // Readers holding this content besides the owner of this handle
+    bool sharedWithReaders() const {
+        return bytes.use_count() > 1;
+    }
+};
+
 // Class representing the Cache with LFU eviction policy
+// Capacity is a byte budget: each entry is charged its content size, and files larger
+// than maxObjectFraction of the budget are not admitted so one file cannot flush the cache.
 class Cache {
 private:
-    int capacity;
-    int currentSize;
+    size_t capacity;      // Byte budget
+    size_t currentSize;   // Bytes currently cached
+    size_t maxObjectSize; // Largest file admitted, capacity * maxObjectFraction
+    double maxObjectFraction;
+
+    // Frequency bucket: the names of all entries accessed `frequency` times,
+    // most recently used at the front
+    struct FrequencyNode {
+        int frequency;
+        list<string> names;
+    };
 
     // Structure to hold cache entries
     struct CacheEntry {
-        File file;
+        FileHandle content;
         int frequency;
-        int timestamp; // To resolve ties in frequency (older entries have lower timestamps)
+        list<FrequencyNode>::iterator node;  // Bucket for this entry's frequency
+        list<string>::iterator position;     // Position inside node->names
+        list<const string*>::iterator classPosition;  // Position in classRecency, if in a slab
     };
 
     unordered_map<string, CacheEntry> cacheMap;
 
-    // Min-heap to determine which file to evict based on frequency and timestamp
-    // The pair contains (frequency, timestamp) as the key for ordering, and file name as the value
-    priority_queue<pair<pair<int, int>, string>, vector<pair<pair<int, int>, string>>, std::greater<pair<pair<int, int>, string>>> minHeap;
+    // Buckets in ascending frequency order, only non-empty ones are kept. The eviction
+    // victim is the back (least recent) of the first bucket, which is the same
+    // (frequency, last access) order the old min-heap used, but every operation is O(1)
+    // and memory stays proportional to the number of cached entries.
+    list<FrequencyNode> frequencies;
+
+    // Optional TinyLFU admission filter and its counters
+    unique_ptr<FrequencySketch> sketch;
+    long long admitted;
+    long long rejected;
+
+    LatencyHistogram evictionLatency;  // Nanoseconds per eviction, logging excluded
+    long long pinnedEvictions;         // Evicted or replaced while readers still held handles
+
+    // Optional slab allocator for cached content; files larger than a slab page are kept
+    // on the heap, and files whose size class is out of chunks are not cached
+    shared_ptr<SlabAllocator> slabs;
+    long long slabFallbacks;
+    long long slabRefusals;
+
+    // Entries held in slab chunks, also kept in a recency list per size class (keyed by
+    // chunk size, most recent first, pointing at cacheMap keys). A class that is out of
+    // chunks gives up its own least recently used entry, as memcached does: scanning the
+    // global LFU order for one would fail once a class holds only hot entries.
+    unordered_map<size_t, list<const string*>> classRecency;
+
+    // Optional what-if counters for a larger and a smaller budget (see GhostList.h)
+    unique_ptr<GhostList> ghosts;
+    unique_ptr<ShadowTier> shadow;
+    long long lookups;
+
+    // Bytes an entry counts against the budget: its slab chunk when slabs are in use,
+    // so the budget covers the memory really held rather than the content length
+    size_t charge(size_t bytes) const {
+        size_t chunk = slabs ? slabs->chunkSize(bytes) : 0;
+        return chunk ? chunk : bytes;
+    }
+
+    // Buffer for content being cached, moved out of `content` unless it goes to a slab.
+    // Size classes fill up independently, so when the file's class has no free chunk the
+    // least frequently used entries of that same class are evicted first, as in memcached.
+    // Invalid if that frees nothing: the heap is not used instead, which keeps the memory
+    // held by slabs and oversized files within the budget.
+    FileHandle store(const string& name, string& content) {
+        size_t chunk = slabs ? slabs->chunkSize(content.size()) : 0;
+        if (!chunk) {
+            if (slabs) slabFallbacks++;
+            return FileHandle(std::move(content));
+        }
+        FileHandle handle = FileHandle::inSlab(slabs, content);
+        while (!handle.valid()) {
+            const string* victim = victimInClass(chunk, name);
+            if (!victim) {
+                slabRefusals++;
+                break;
+            }
+            evict(string(*victim));
+            handle = FileHandle::inSlab(slabs, content);
+        }
+        return handle;
+    }
+
+    // Least recently used entry of a slab class other than `keep`, or nullptr
+    const string* victimInClass(size_t chunk, const string& keep) const {
+        auto recency = classRecency.find(chunk);
+        if (recency == classRecency.end()) return nullptr;
+        for (auto it = recency->second.rbegin(); it != recency->second.rend(); ++it) {
+            if (**it != keep) return *it;
+        }
+        return nullptr;
+    }
+
+    // Slab class of an entry's content, 0 if it is on the heap
+    size_t slabClassOf(const CacheEntry& entry) const {
+        return slabs ? slabs->chunkSize(entry.content.size()) : 0;
+    }
+
+    // `key` must be the entry's key in cacheMap, which stays put while the entry exists
+    void linkClass(const string& key, CacheEntry& entry) {
+        size_t chunk = slabClassOf(entry);
+        if (!chunk) return;
+        auto& recency = classRecency[chunk];
+        recency.push_front(&key);
+        entry.classPosition = recency.begin();
+    }
+
+    // Must run before the entry's content is replaced
+    void unlinkClass(CacheEntry& entry) {
+        size_t chunk = slabClassOf(entry);
+        if (chunk) classRecency[chunk].erase(entry.classPosition);
+    }
+
+    // Add a new entry at the front of the frequency-1 bucket
+    void linkEntry(const string& name, CacheEntry& entry) {
+        if (frequencies.empty() || frequencies.front().frequency != 1) {
+            frequencies.push_front({1, {}});
+        }
+        entry.frequency = 1;
+        entry.node = frequencies.begin();
+        entry.node->names.push_front(name);
+        entry.position = entry.node->names.begin();
+    }
 
-    int globalTimestamp;
+    // Move an entry into the bucket for frequency + 1, creating it if needed
+    void touch(CacheEntry& entry) {
+        auto current = entry.node;
+        auto next = std::next(current);
+        if (next == frequencies.end() || next->frequency != current->frequency + 1) {
+            next = frequencies.insert(next, {current->frequency + 1, {}});
+        }
+        // splice relinks the list node, so entry.position stays valid
+        next->names.splice(next->names.begin(), current->names, entry.position);
+        if (current->names.empty()) {
+            frequencies.erase(current);
+        }
+        entry.node = next;
+        entry.frequency++;
+        if (size_t chunk = slabClassOf(entry)) {
+            auto& recency = classRecency[chunk];
+            recency.splice(recency.begin(), recency, entry.classPosition);
+        }
+    }
+
+    void unlinkEntry(CacheEntry& entry) {
+        entry.node->names.erase(entry.position);
+        if (entry.node->names.empty()) {
+            frequencies.erase(entry.node);
+        }
+    }
+
+    // Next eviction victim other than `keep`, or nullptr if there is none.
+    // `keep` can only shadow one candidate, so this looks at most two names.
+    const string* victimExcluding(const string& keep) const {
+        for (const auto& node : frequencies) {
+            for (auto it = node.names.rbegin(); it != node.names.rend(); ++it) {
+                if (*it != keep) return &*it;
+            }
+        }
+        return nullptr;
+    }
+
+    // Evict least frequently used entries until `incoming` more bytes fit in the budget.
+    // The entry named `keep` (if any) is never chosen, so an update cannot evict itself.
+    void evictUntilFits(size_t incoming, const string& keep = "") {
+        while (currentSize + incoming > capacity) {
+            const string* victim = victimExcluding(keep);
+            if (!victim) break;
+            evict(string(*victim));
+        }
+    }
+
+    // Takes the name by value: the caller's copy usually lives in the bucket being unlinked
+    void evict(string evictName) {
+        auto start = chrono::steady_clock::now();
+        auto it = cacheMap.find(evictName);
+        currentSize -= charge(it->second.content.size());
+        if (it->second.content.sharedWithReaders()) pinnedEvictions++;  // Freed when they let go
+        unlinkClass(it->second);
+        unlinkEntry(it->second);
+        if (ghosts) {
+            ghosts->evicted(evictName, charge(it->second.content.size()));
+            shadow->removed(evictName);
+        }
+        cacheMap.erase(it);
+        evictionLatency.record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+        cout << "Evicted file '" << evictName << "' from cache (LFU Policy).\n";
+    }
 
 public:
-    Cache(int capacity) : capacity(capacity), currentSize(0), globalTimestamp(0) {}
+    Cache(size_t capacity, double maxObjectFraction = 0.5)
+        : capacity(capacity), currentSize(0),
+          maxObjectSize(static_cast<size_t>(capacity * maxObjectFraction)), maxObjectFraction(maxObjectFraction),
+          admitted(0), rejected(0), pinnedEvictions(0), slabFallbacks(0), slabRefusals(0), lookups(0) {}
+
+    // Put a TinyLFU filter in front of put(): a new file that would force an eviction is only
+    // admitted if its estimated recent frequency is higher than that of the eviction victim.
+    // expectedEntries sizes the sketch; the doorkeeper filters out first-time accesses.
+    void enableAdmissionFilter(size_t expectedEntries, bool useDoorkeeper = true) {
+        sketch = make_unique<FrequencySketch>(expectedEntries, useDoorkeeper);
+    }
+
+    // Keep cached content in a memcached-style slab allocator limited to the byte budget,
+    // instead of one heap string per file (see SlabAllocator.h). Call before caching anything.
+    void enableSlabAllocator(size_t pageSize = 1 << 20, double growthFactor = 1.25) {
+        if (!cacheMap.empty()) return;
+        slabs = make_shared<SlabAllocator>(capacity, pageSize, growthFactor);
+    }
+
+    // Count what `steps` steps of stepBytes more budget would have gained (kept as a ghost
+    // list of evicted names, up to that much evicted content) and what one step less would
+    // have lost. Costs a few dozen bytes per cached and per ghost name.
+    void enableCapacityEstimates(size_t stepBytes, int steps = 4) {
+        ghosts = make_unique<GhostList>(stepBytes, steps);
+        shadow = make_unique<ShadowTier>(capacity > stepBytes ? capacity - stepBytes : 0);
+        for (const auto& pair : cacheMap) {
+            shadow->inserted(pair.first, charge(pair.second.content.size()));
+        }
+    }
+
+    // Counts since enableCapacityEstimates, in bytes; empty if it was not called
+    CapacityEstimate capacityEstimate() const {
+        CapacityEstimate estimate;
+        if (!ghosts) return estimate;
+        estimate.step = ghosts->stepSize();
+        estimate.extraHits = ghosts->extraHits();
+        estimate.lostHits = shadow->lostHits();
+        estimate.accesses = lookups;
+        return estimate;
+    }
+
+    // Change the byte budget. Nothing is evicted here: a lower budget is reached by
+    // evictOverBudget, or by the next put() that needs room.
+    void setCapacity(size_t bytes) {
+        capacity = bytes;
+        maxObjectSize = static_cast<size_t>(bytes * maxObjectFraction);
+        if (slabs) slabs->setMemoryLimit(bytes);
+        if (shadow) shadow->resize(bytes > ghosts->stepSize() ? bytes - ghosts->stepSize() : 0);
+    }
+
+    // Evict up to maxEvictions entries while over budget; true if still over it
+    bool evictOverBudget(int maxEvictions) {
+        for (int i = 0; i < maxEvictions && currentSize > capacity; ++i) {
+            const string* victim = victimExcluding("");
+            if (!victim) break;
+            evict(string(*victim));
+        }
+        return currentSize > capacity && !cacheMap.empty();
+    }
+
+    // Give slab pages left empty by evictions back to the system. Evictions in LFU order
+    // leave live chunks scattered over the pages, so while the pages held still exceed the
+    // budget, up to maxEvictions entries of the sparsest page are evicted to empty it, as
+    // memcached's page mover does. True if this should be called again.
+    bool releaseMemory(int maxEvictions) {
+        if (!slabs) return false;
+        slabs->setMemoryLimit(capacity);
+        if (slabs->reservedBytes() <= slabs->memoryLimit()) return false;
+        auto [page, chunk] = slabs->sparsestPage();
+        auto recency = classRecency.find(chunk);
+        if (!page || recency == classRecency.end()) return false;
+        vector<string> victims;
+        for (const string* key : recency->second) {
+            if ((int)victims.size() == maxEvictions) break;
+            if (slabs->onPage(page, cacheMap.at(*key).content.view().data())) victims.push_back(*key);
+        }
+        for (const string& victim : victims) {
+            evict(victim);
+        }
+        slabs->setMemoryLimit(capacity);
+        return !victims.empty();  // None: the page is held by readers' handles alone
+    }
+
+    // Move a free slab page to the size class that was short of chunks most often
+    bool rebalanceSlabs() {
+        return slabs && slabs->rebalance();
+    }
+
+    // Files above the size limit are served from the filesystem but never cached
+    bool admits(const File& file) const {
+        return file.size <= maxObjectSize;
+    }
+
+    size_t usedBytes() const {
+        return currentSize;
+    }
+
+    size_t capacityBytes() const {
+        return capacity;
+    }
+
+    const LatencyHistogram& evictionLatencies() const {
+        return evictionLatency;
+    }
+
+    long long evictedWhilePinned() const {
+        return pinnedEvictions;
+    }
 
     // Check if a file is in the cache
     bool isCached(const string& name) const {
         return cacheMap.find(name) != cacheMap.end();
     }
 
-    // Get a file from cache
-    File get(const string& name) {
-        if (isCached(name)) {
-            // Update frequency and timestamp
-            cacheMap[name].frequency += 1;
-            cacheMap[name].timestamp = globalTimestamp++;
-            // Push the updated entry into the minHeap
-            minHeap.push({{cacheMap[name].frequency, cacheMap[name].timestamp}, name});
-            return cacheMap[name].file;
+    // Get a handle on a cached file's content; an invalid handle if it is not cached.
+    // Only a reference count changes hands, so the cost does not depend on the file size.
+    // Only a hit counts in the admission sketch: a miss is counted once, by the put that
+    // caches the loaded file, so the doorkeeper still sees a first access as the first.
+    FileHandle get(const string& name) {
+        auto it = cacheMap.find(name);
+        if (ghosts) {
+            lookups++;
+            if (it != cacheMap.end()) {
+                shadow->hit(name);
+            } else {
+                ghosts->missed(name);
+            }
+        }
+        if (it != cacheMap.end()) {
+            if (sketch) sketch->increment(name);
+            // Update frequency and recency
+            touch(it->second);
+            return it->second.content;
         } else {
-            // Return an empty file if not in cache
-            return File();
+            return FileHandle();
         }
     }
 
-    // Add a file to the cache
-    void put(const File& file) {
-        if (capacity == 0) return;
+    // Like get, but not an access: frequency, recency, admission and capacity estimates
+    // are left as they are. For callers that already counted this request.
+    FileHandle peek(const string& name) const {
+        auto it = cacheMap.find(name);
+        return it != cacheMap.end() ? it->second.content : FileHandle();
+    }
+
+    // Add a file to the cache. The content is moved into an immutable buffer, and a handle
+    // on it is returned whether or not the file was admitted.
+    FileHandle put(File file) {
+        if (capacity == 0) return FileHandle(std::move(file.content));
+        if (sketch) sketch->increment(file.name);
+        size_t charged = charge(file.size);
 
-        if (isCached(file.name)) {
-            // Update the file content and frequency
-            cacheMap[file.name].file = file;
-            cacheMap[file.name].frequency += 1;
-            cacheMap[file.name].timestamp = globalTimestamp++;
-            minHeap.push({{cacheMap[file.name].frequency, cacheMap[file.name].timestamp}, file.name});
-            return;
+        auto existing = cacheMap.find(file.name);
+        if (existing != cacheMap.end()) {
+            currentSize -= charge(existing->second.content.size());
+            if (existing->second.content.sharedWithReaders()) pinnedEvictions++;
+            unlinkClass(existing->second);
+            if (shadow) shadow->removed(file.name);
+            if (!admits(file)) {
+                // The new content is too large to keep cached
+                unlinkEntry(existing->second);
+                cacheMap.erase(existing);
+                cout << "File '" << file.name << "' grew past the admission limit; removed from cache.\n";
+                return FileHandle(std::move(file.content));
+            }
+            // Update the file content and frequency; readers of the old version keep it
+            existing->second.content = FileHandle();  // Frees the old chunk first, unless pinned
+            existing->second.content = store(file.name, file.content);
+            if (!existing->second.content.valid()) {
+                unlinkEntry(existing->second);
+                cacheMap.erase(existing);
+                cout << "No slab space for the new version of '" << file.name << "'; removed from cache.\n";
+                return FileHandle(std::move(file.content));
+            }
+            linkClass(existing->first, existing->second);
+            touch(existing->second);
+            currentSize += charged;
+            if (shadow) shadow->inserted(file.name, charged);
+            // A larger version may push the cache over budget
+            evictUntilFits(0, file.name);
+            return existing->second.content;
         }
 
-        if (currentSize >= capacity) {
-            // Evict the least frequently used file
-            while (!minHeap.empty()) {
-                auto top = minHeap.top();
-                minHeap.pop();
-                string evictName = top.second;
-                // Verify if this is the current entry
-                if (cacheMap.find(evictName) != cacheMap.end() &&
-                    cacheMap[evictName].frequency == top.first.first &&
-                    cacheMap[evictName].timestamp == top.first.second) {
-                    // Evict this file
-                    cacheMap.erase(evictName);
-                    currentSize--;
-                    cout << "Evicted file '" << evictName << "' from cache (LFU Policy).\n";
-                    break;
-                }
+        if (!admits(file)) {
+            cout << "File '" << file.name << "' (" << file.size << " bytes) exceeds the admission limit of "
+                 << maxObjectSize << " bytes; not cached.\n";
+            return FileHandle(std::move(file.content));
+        }
+
+        // A candidate that is colder than the entry it would displace is not admitted
+        if (sketch && currentSize + charged > capacity) {
+            const string* victim = victimExcluding("");
+            if (victim && sketch->estimate(file.name) <= sketch->estimate(*victim)) {
+                rejected++;
+                cout << "File '" << file.name << "' rejected by admission filter (colder than '" << *victim << "').\n";
+                return FileHandle(std::move(file.content));
             }
         }
+        if (sketch) admitted++;
+
+        // Evict least frequently used files until the new one fits
+        evictUntilFits(charged);
 
         // Add the new file to cache
-        CacheEntry entry;
-        entry.file = file;
-        entry.frequency = 1;
-        entry.timestamp = globalTimestamp++;
-        cacheMap[file.name] = entry;
-        minHeap.push({{entry.frequency, entry.timestamp}, file.name});
-        currentSize++;
+        FileHandle content = store(file.name, file.content);
+        if (!content.valid()) {
+            cout << "No slab space for file '" << file.name << "'; not cached.\n";
+            return FileHandle(std::move(file.content));
+        }
+        auto inserted = cacheMap.emplace(file.name, CacheEntry()).first;
+        CacheEntry& entry = inserted->second;
+        entry.content = content;
+        linkEntry(file.name, entry);
+        linkClass(inserted->first, entry);
+        currentSize += charged;
+        if (ghosts) {
+            ghosts->forget(file.name);
+            shadow->inserted(file.name, charged);
+        }
         cout << "File '" << file.name << "' added to cache.\n";
+        return content;
     }
 
     // Display cache contents
     void displayCache() const {
-        cout << "Current Cache Contents:\n";
+        cout << "Current Cache Contents (" << currentSize << " / " << capacity << " bytes):\n";
         for (const auto& pair : cacheMap) {
-            cout << " - " << pair.first << " (Freq: " << pair.second.frequency << ")\n";
+            cout << " - " << pair.first << " (Freq: " << pair.second.frequency
+                 << ", Size: " << pair.second.content.size() << " bytes)\n";
         }
     }
+
+    // Display per-class slab utilization, if slabs are in use
+    void displaySlabStats() const {
+        if (!slabs) return;
+        slabs->printStats(cout);
+        cout << "Files larger than a slab page (kept on the heap): " << slabFallbacks
+             << " | Not cached for lack of slab space: " << slabRefusals << endl;
+    }
+
+    // Display the what-if counters, if enabled
+    void displayCapacityEstimates() const {
+        if (!ghosts) return;
+        cout << "Capacity What-If  : " << lookups << " lookups, " << ghosts->size() << " ghost names\n";
+        capacityEstimate().print(cout, "bytes");
+    }
+
+    // Display admission filter counters and sketch footprint
+    void displayAdmissionStats() const {
+        if (!sketch) return;
+        cout << "Admission Filter : TinyLFU (" << sketch->memoryBytes() << " bytes of sketch)" << endl;
+        cout << "Admitted / Rejected: " << admitted << " / " << rejected << endl;
+    }
+};
+
+// Cache of fixed-size blocks of files, keyed by (file, block index), for reads of a byte
+// range: a read loads only the blocks it touches that are not cached, and blocks are
+// evicted one at a time, least recently used first, so a large file can be partly
+// resident. Capacity is a byte budget over the cached blocks. A block shorter than the
+// block size is the last one of its file.
+class BlockCache {
+private:
+    using Position = list<pair<const string*, uint64_t>>::iterator;
+
+    struct Block {
+        string data;
+        Position position;  // In recency
+        bool prefetched;    // Read ahead and not requested since
+    };
+
+    size_t blockBytes;
+    size_t capacity;
+    size_t currentSize;
+    unordered_map<string, unordered_map<uint64_t, Block>> files;  // Blocks of each file, by index
+    list<pair<const string*, uint64_t>> recency;  // (key in files, block index), most recent first
+    uint64_t invalidations;  // Bumped by every invalidate(), see version()
+    long long hits, misses, evictions;
+    long long prefetches, prefetchHits, prefetchesWasted;  // Wasted: evicted before being requested
+
+    void evictOne() {
+        auto [name, index] = recency.back();
+        auto file = files.find(*name);
+        Block& block = file->second.at(index);
+        currentSize -= block.data.size();
+        if (block.prefetched) prefetchesWasted++;
+        recency.pop_back();
+        file->second.erase(index);
+        if (file->second.empty()) files.erase(file);
+        evictions++;
+    }
+
+public:
+    BlockCache(size_t capacity, size_t blockSize)
+        : blockBytes(blockSize), capacity(capacity), currentSize(0), invalidations(0), hits(0), misses(0), evictions(0),
+          prefetches(0), prefetchHits(0), prefetchesWasted(0) {
+        if (blockSize == 0) throw invalid_argument("block size must be positive");
+    }
+
+    size_t blockSize() const {
+        return blockBytes;
+    }
+
+    size_t capacityBytes() const {
+        return capacity;
+    }
+
+    // Change the byte budget; a lower one is reached by evictOverBudget or the next insert
+    void setCapacity(size_t bytes) {
+        capacity = bytes;
+    }
+
+    // Evict up to maxEvictions blocks while over budget; true if still over it
+    bool evictOverBudget(int maxEvictions) {
+        for (int i = 0; i < maxEvictions && currentSize > capacity && !recency.empty(); ++i) {
+            evictOne();
+        }
+        return currentSize > capacity && !recency.empty();
+    }
+
+    // The cached block, or nullptr. Valid until the cache is next modified.
+    const string* find(const string& name, uint64_t index) {
+        auto file = files.find(name);
+        if (file != files.end()) {
+            auto block = file->second.find(index);
+            if (block != file->second.end()) {
+                hits++;
+                if (block->second.prefetched) {
+                    block->second.prefetched = false;
+                    prefetchHits++;
+                }
+                recency.splice(recency.begin(), recency, block->second.position);
+                return &block->second.data;
+            }
+        }
+        misses++;
+        return nullptr;
+    }
+
+    // Whether a block is cached, without counting it as an access
+    bool contains(const string& name, uint64_t index) const {
+        auto file = files.find(name);
+        return file != files.end() && file->second.count(index);
+    }
+
+    // Cache a block read from the backing store, evicting least recently used blocks to fit.
+    // A prefetched block does not replace one that is already cached.
+    void insert(const string& name, uint64_t index, string data, bool prefetched = false) {
+        if (data.empty() || data.size() > capacity) return;
+        auto file = files.try_emplace(name).first;
+        auto existing = file->second.find(index);
+        if (existing != file->second.end()) {
+            if (prefetched) return;
+            currentSize -= existing->second.data.size();
+            recency.erase(existing->second.position);
+            file->second.erase(existing);
+        }
+        while (currentSize + data.size() > capacity && !recency.empty()) {
+            evictOne();
+            file = files.try_emplace(name).first;  // Evicting the file's last block drops it
+        }
+        currentSize += data.size();
+        recency.emplace_front(&file->first, index);
+        file->second[index] = Block{std::move(data), recency.begin(), prefetched};
+        if (prefetched) prefetches++;
+    }
+
+    // Drop every cached block of a file, e.g. after it was written
+    void invalidate(const string& name) {
+        invalidations++;
+        auto file = files.find(name);
+        if (file == files.end()) return;
+        for (auto& [index, block] : file->second) {
+            currentSize -= block.data.size();
+            recency.erase(block.position);
+        }
+        files.erase(file);
+    }
+
+    // Changes whenever a file is invalidated. A load that read the backing store outside
+    // the cache lock only inserts its blocks if the version is the one it started with,
+    // so it cannot bring back content that a write has replaced meanwhile.
+    uint64_t version() const {
+        return invalidations;
+    }
+
+    void displayStats() const {
+        cout << "Block Cache      : " << blockBytes << "-byte blocks, " << recency.size() << " cached ("
+             << currentSize << " / " << capacity << " bytes)" << endl;
+        cout << "Block Hits / Misses / Evictions: " << hits << " / " << misses << " / " << evictions << endl;
+        if (prefetches > 0) {
+            cout << "Blocks Read Ahead: " << prefetches << " | Requested: " << prefetchHits
+                 << " | Evicted unrequested: " << prefetchesWasted << endl;
+        }
+    }
+};
+
+struct ReadaheadOptions {
+    size_t initialWindow = 128 << 10;  // Bytes read ahead on a stream's first sequential read
+    size_t maxWindow = 2 << 20;
+    size_t maxStreams = 1024;          // Streams tracked; the least recently read is forgotten
+    int workers = 2;                   // Threads doing the ahead-reads
+    size_t maxQueued = 64;             // Ahead-reads waiting for a worker; the oldest is dropped
+};
+
+// Decides what to read ahead of sequential reads through a file, in the style of the Linux
+// page cache readahead. Each file is a stream that remembers where its next sequential read
+// would start. The first sequential read schedules a window past it; once the reader is
+// halfway into the last window scheduled, the next one is scheduled behind it at twice the
+// size (up to maxWindow), so reads ahead stay in flight while the reader consumes earlier
+// ones. A read anywhere else halves the window and cancels the pipeline until the stream
+// is sequential again. Not thread-safe; this only decides, the caller does the reads.
+class ReadaheadDetector {
+public:
+    struct Range {
+        uint64_t offset = 0;
+        size_t length = 0;  // 0 when there is nothing to read ahead
+    };
+
+    explicit ReadaheadDetector(const ReadaheadOptions& options)
+        : options(options), sequentialReads(0), randomReads(0), scheduledBytes(0) {}
+
+    Range onRead(const string& name, uint64_t offset, size_t length) {
+        auto it = streams.find(name);
+        bool known = it != streams.end();
+        if (known) {
+            order.splice(order.begin(), order, it->second.position);
+        } else {
+            if (streams.size() >= options.maxStreams && !order.empty()) {
+                streams.erase(order.back());
+                order.pop_back();
+            }
+            order.push_front(name);
+            it = streams.emplace(name, Stream{0, 0, 0, 0, order.begin()}).first;
+        }
+        Stream& stream = it->second;
+        uint64_t end = offset + length;
+        Range range;
+
+        // A new stream counts as sequential only when it starts at the beginning of the file
+        if (known ? offset == stream.next : offset == 0) {
+            sequentialReads++;
+            if (end >= stream.trigger) {
+                stream.window = stream.window ? min(stream.window * 2, options.maxWindow) : options.initialWindow;
+                range.offset = max(end, stream.aheadEnd);
+                range.length = stream.window;
+                stream.trigger = range.offset + range.length / 2;
+                stream.aheadEnd = range.offset + range.length;
+                scheduledBytes += range.length;
+            }
+        } else {
+            randomReads++;
+            stream.window = stream.window / 2 >= options.initialWindow ? stream.window / 2 : 0;
+            stream.trigger = stream.aheadEnd = 0;
+        }
+        stream.next = end;
+        return range;
+    }
+
+    void displayStats() const {
+        cout << "Readahead        : " << sequentialReads << " sequential / " << randomReads << " random reads, "
+             << scheduledBytes << " bytes scheduled" << endl;
+    }
+
+private:
+    struct Stream {
+        uint64_t next;      // Offset a sequential read starts at
+        uint64_t trigger;   // Reading past here schedules the next window
+        uint64_t aheadEnd;  // End of the last window scheduled
+        size_t window;
+        list<string>::iterator position;  // In order
+    };
+
+    ReadaheadOptions options;
+    unordered_map<string, Stream> streams;
+    list<string> order;  // Most recently read first
+    long long sequentialReads, randomReads, scheduledBytes;
 };
 
 // Class to optimize cache based on access patterns
@@ -237,107 +1263,627 @@ public:
     }
 };
 
+// Coalesces concurrent loads of the same key: the first caller (the leader) runs the
+// loader and every caller that arrives while it is running waits for that result instead
+// of loading again. An exception thrown by the loader is rethrown in all waiters.
+template <typename Value>
+class SingleFlight {
+private:
+    struct Flight {
+        promise<Value> result;
+        shared_future<Value> future;
+        atomic<bool> invalidated{false};
+    };
+
+    mutex lock;
+    unordered_map<string, shared_ptr<Flight>> inFlight;
+    atomic<long long> loads{0}, coalesced{0}, timeouts{0}, failures{0};
+
+public:
+    // Returns the loaded value. The loader is passed a flag that invalidate() sets, so it can
+    // skip publishing a value that a concurrent write has made stale. With a nonzero timeout
+    // waiters give up after that long with a runtime_error; the leader is never interrupted.
+    template <typename Loader>
+    Value run(const string& key, Loader loader, chrono::milliseconds timeout = chrono::milliseconds(0)) {
+        shared_ptr<Flight> flight;
+        bool leader = false;
+        {
+            lock_guard<mutex> guard(lock);
+            auto it = inFlight.find(key);
+            if (it != inFlight.end()) {
+                flight = it->second;
+            } else {
+                flight = make_shared<Flight>();
+                flight->future = flight->result.get_future().share();
+                inFlight.emplace(key, flight);
+                leader = true;
+            }
+        }
+
+        if (!leader) {
+            coalesced++;
+            if (timeout.count() > 0 && flight->future.wait_for(timeout) == future_status::timeout) {
+                timeouts++;
+                throw runtime_error("timed out waiting for load of '" + key + "'");
+            }
+            return flight->future.get();  // Rethrows the leader's exception
+        }
+
+        loads++;
+        Value value;
+        try {
+            value = loader(static_cast<const atomic<bool>&>(flight->invalidated));
+            flight->result.set_value(value);
+        } catch (...) {
+            failures++;
+            flight->result.set_exception(current_exception());
+            finish(key, flight);
+            throw;
+        }
+        finish(key, flight);
+        return value;
+    }
+
+    // Marks an in-flight load of key as stale and lets the next miss start a fresh one
+    void invalidate(const string& key) {
+        lock_guard<mutex> guard(lock);
+        auto it = inFlight.find(key);
+        if (it != inFlight.end()) {
+            it->second->invalidated = true;
+            inFlight.erase(it);
+        }
+    }
+
+    long long loadCount() const { return loads; }
+    long long coalescedCount() const { return coalesced; }
+    long long timeoutCount() const { return timeouts; }
+    long long failureCount() const { return failures; }
+
+private:
+    void finish(const string& key, const shared_ptr<Flight>& flight) {
+        lock_guard<mutex> guard(lock);
+        auto it = inFlight.find(key);
+        if (it != inFlight.end() && it->second == flight) {
+            inFlight.erase(it);
+        }
+    }
+};
+
 // Integrate FileSystem, Cache, and CacheOptimizer
+// Safe to call from several threads. Cache, access statistics and metrics share one lock;
+// backing store reads run outside it, with concurrent misses on a key coalesced into one load.
 class FileSystemCacheOptimizer {
 private:
-    FileSystem fs;
+    unique_ptr<StorageBackend> fs;
     Cache cache;
     CacheOptimizer optimizer;
     PerformanceMetrics metrics;
+    mutable mutex stateLock;
+    SingleFlight<FileHandle> loads;
+    chrono::milliseconds loadTimeout{0};
+    unique_ptr<BlockCache> blocks;  // For read(name, offset, length), if enabled
+
+    // Budgets as configured, which setBudgetFraction scales (e.g. for the memory governor)
+    size_t fullCapacity;
+    size_t fullBlockCapacity = 0;
+    double budgetFraction = 1.0;
+    static constexpr int evictionBatch = 64;  // Evictions per lock hold when shrinking
+    unique_ptr<MemoryGovernor> governor;
+
+    // Readahead into the block cache, if enabled: read() queues the ranges the detector
+    // picks and worker threads load them
+    unique_ptr<ReadaheadDetector> readahead;
+    size_t maxQueuedReadaheads = 0;
+    mutable mutex readaheadLock;
+    condition_variable readaheadWakeup;
+    deque<pair<string, ReadaheadDetector::Range>> readaheadQueue;
+    vector<thread> readaheadWorkers;
+    bool stopping = false;
+    long long droppedReadaheads = 0;
+    // Ranges workers are loading, guarded by stateLock. A read that overlaps one waits for
+    // it rather than loading the same blocks again.
+    unordered_multimap<string, ReadaheadDetector::Range> readingAhead;
+    condition_variable readaheadDone;
+
+    static uint64_t elapsedNanos(chrono::steady_clock::time_point start) {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    }
+
+    // Loads a missed file from the backing store and caches it. Only one thread per file
+    // does the read; the rest share its result.
+    FileHandle load(const string& name) {
+        return loads.run(name, [&](const atomic<bool>& invalidated) {
+            {
+                // A previous load may have finished between our miss and becoming leader
+                lock_guard<mutex> guard(stateLock);
+                FileHandle cached = cache.peek(name);
+                if (cached.valid()) {
+                    return cached;
+                }
+            }
+            string content = fs->readFile(name);
+            if (content.empty()) {
+                return FileHandle();
+            }
+            lock_guard<mutex> guard(stateLock);
+            if (invalidated) {
+                return FileHandle(std::move(content));
+            }
+            return cache.put(File(name, std::move(content)));
+        }, loadTimeout);
+    }
+
+    // Loads the blocks in [first, first + parts.size()) that are not `cached` into `parts`,
+    // one backing store read per run of missing blocks, and appends their positions to
+    // `loaded`. `end` is lowered to just past the last block of the file if one is reached.
+    void loadBlocks(const string& name, uint64_t first, size_t blockSize, vector<string>& parts,
+                    const vector<bool>& cached, size_t& end, vector<uint64_t>& loaded) {
+        for (size_t i = 0; i < end;) {
+            if (cached[i]) {
+                ++i;
+                continue;
+            }
+            size_t run = i;
+            while (run < end && !cached[run]) ++run;
+            string data = fs->readRange(name, (first + i) * blockSize, (run - i) * blockSize);
+            for (size_t j = i; j < run; ++j) {
+                size_t at = (j - i) * blockSize;
+                if (at >= data.size()) {
+                    end = j;
+                    break;
+                }
+                parts[j] = data.substr(at, blockSize);
+                loaded.push_back(j);
+                if (parts[j].size() < blockSize) {
+                    end = j + 1;
+                    break;
+                }
+            }
+            i = run;
+        }
+    }
+
+    void readaheadLoop() {
+        unique_lock<mutex> guard(readaheadLock);
+        while (true) {
+            readaheadWakeup.wait(guard, [this] { return stopping || !readaheadQueue.empty(); });
+            if (stopping) return;
+            auto [name, range] = std::move(readaheadQueue.front());
+            readaheadQueue.pop_front();
+            guard.unlock();
+            readAhead(name, range);
+            guard.lock();
+        }
+    }
+
+    // Whether a worker is loading part of [offset, offset + length) of the file
+    bool readingAheadOver(const string& name, uint64_t offset, size_t length) const {
+        auto [range, last] = readingAhead.equal_range(name);
+        for (; range != last; ++range) {
+            if (range->second.offset < offset + length && offset < range->second.offset + range->second.length) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Loads the blocks of a readahead range that are not cached yet
+    void readAhead(const string& name, ReadaheadDetector::Range range) {
+        size_t blockSize;
+        uint64_t first, version;
+        vector<string> parts;
+        vector<bool> cached;
+        {
+            lock_guard<mutex> guard(stateLock);
+            readingAhead.emplace(name, range);
+            blockSize = blocks->blockSize();
+            first = range.offset / blockSize;
+            size_t count = (range.offset + range.length - 1) / blockSize - first + 1;
+            parts.resize(count);
+            cached.resize(count);
+            for (size_t i = 0; i < count; ++i) {
+                cached[i] = blocks->contains(name, first + i);
+            }
+            version = blocks->version();
+        }
+        size_t end = parts.size();
+        vector<uint64_t> loaded;
+        loadBlocks(name, first, blockSize, parts, cached, end, loaded);
+        {
+            lock_guard<mutex> guard(stateLock);
+            if (blocks->version() == version) {
+                for (size_t i : loaded) {
+                    blocks->insert(name, first + i, std::move(parts[i]), true);
+                }
+            }
+            auto registered = readingAhead.equal_range(name).first;
+            while (registered->second.offset != range.offset) ++registered;
+            readingAhead.erase(registered);
+        }
+        readaheadDone.notify_all();
+    }
+
+    void stopReadahead() {
+        {
+            lock_guard<mutex> guard(readaheadLock);
+            stopping = true;
+        }
+        readaheadWakeup.notify_all();
+        for (thread& worker : readaheadWorkers) {
+            worker.join();
+        }
+        readaheadWorkers.clear();
+    }
 
 public:
-    FileSystemCacheOptimizer(int cacheCapacity) : cache(cacheCapacity) {}
+    // Uses the in-memory FileSystem unless a backend (e.g. PosixFileSystem) is given
+    FileSystemCacheOptimizer(size_t cacheCapacityBytes, double maxObjectFraction = 0.5,
+                             unique_ptr<StorageBackend> backend = nullptr)
+        : fs(backend ? std::move(backend) : make_unique<FileSystem>()), cache(cacheCapacityBytes, maxObjectFraction),
+          fullCapacity(cacheCapacityBytes) {}
+
+    ~FileSystemCacheOptimizer() {
+        governor.reset();
+        stopReadahead();
+    }
+
+    // Enable TinyLFU admission on cache misses (see Cache::enableAdmissionFilter)
+    void enableAdmissionFilter(size_t expectedEntries, bool useDoorkeeper = true) {
+        lock_guard<mutex> guard(stateLock);
+        cache.enableAdmissionFilter(expectedEntries, useDoorkeeper);
+    }
+
+    // Track extra and lost hits for budgets stepBytes larger and smaller (see Cache::enableCapacityEstimates)
+    void enableCapacityEstimates(size_t stepBytes, int steps = 4) {
+        lock_guard<mutex> guard(stateLock);
+        cache.enableCapacityEstimates(stepBytes, steps);
+    }
+
+    CapacityEstimate capacityEstimate() const {
+        lock_guard<mutex> guard(stateLock);
+        return cache.capacityEstimate();
+    }
+
+    // Keep cached content in slabs (see Cache::enableSlabAllocator); call before any reads
+    void enableSlabAllocator(size_t pageSize = 1 << 20, double growthFactor = 1.25) {
+        lock_guard<mutex> guard(stateLock);
+        cache.enableSlabAllocator(pageSize, growthFactor);
+    }
+
+    // Serve read(name, offset, length) from a cache of blockSize-byte blocks with its own
+    // byte budget, instead of from the whole-file cache
+    void enableBlockCache(size_t capacityBytes, size_t blockSize = 4096) {
+        lock_guard<mutex> guard(stateLock);
+        fullBlockCapacity = capacityBytes;
+        blocks = make_unique<BlockCache>(static_cast<size_t>(capacityBytes * budgetFraction), blockSize);
+    }
+
+    // Scale the budgets of the cache and the block cache to `fraction` of those configured.
+    // A lower budget is reached by evicting in batches, with the lock released between
+    // them so readers wait for one batch at most, and the memory freed is handed back to
+    // the system: empty slab pages, and free heap through malloc_trim.
+    void setBudgetFraction(double fraction) {
+        fraction = clamp(fraction, 0.0, 1.0);
+        {
+            lock_guard<mutex> guard(stateLock);
+            budgetFraction = fraction;
+            cache.setCapacity(static_cast<size_t>(fullCapacity * fraction));
+            if (blocks) blocks->setCapacity(static_cast<size_t>(fullBlockCapacity * fraction));
+        }
+        for (bool over = true; over;) {
+            lock_guard<mutex> guard(stateLock);
+            over = cache.evictOverBudget(evictionBatch);
+            if (blocks && blocks->evictOverBudget(evictionBatch)) over = true;
+        }
+        for (bool more = true; more;) {
+            lock_guard<mutex> guard(stateLock);
+            more = cache.releaseMemory(evictionBatch);
+        }
+        malloc_trim(0);
+    }
+
+    // Shrink the budgets as memory pressure rises and grow them back as it clears (see
+    // MemoryGovernor), polling on a background thread that also does the evicting
+    void enableMemoryGovernor(MemoryGovernorOptions options = MemoryGovernorOptions()) {
+        if (governor) return;
+        governor = make_unique<MemoryGovernor>(std::move(options),
+                                               [this](double fraction, int) { setBudgetFraction(fraction); });
+        governor->start();
+    }
+
+    // Read ahead of sequential read() calls into the block cache (see ReadaheadDetector),
+    // from background threads. Needs the block cache; call once, before reading. Windows are
+    // capped at a quarter of the block cache, so reads ahead do not flush what they lead to.
+    void enableReadahead(ReadaheadOptions options = ReadaheadOptions()) {
+        {
+            lock_guard<mutex> guard(stateLock);
+            if (!blocks) throw logic_error("enableReadahead needs the block cache (enableBlockCache)");
+            if (readahead) return;
+            options.maxWindow = max(min(options.maxWindow, blocks->capacityBytes() / 4), blocks->blockSize());
+            options.initialWindow = min(options.initialWindow, options.maxWindow);
+            readahead = make_unique<ReadaheadDetector>(options);
+        }
+        maxQueuedReadaheads = options.maxQueued;
+        for (int i = 0; i < max(options.workers, 1); ++i) {
+            readaheadWorkers.emplace_back([this] { readaheadLoop(); });
+        }
+    }
+
+    // How long a reader waits on another thread's load of the same file; 0 waits forever
+    void setLoadTimeout(chrono::milliseconds timeout) {
+        loadTimeout = timeout;
+    }
+
+    // Readers that waited on another thread's load instead of reading the file themselves
+    long long coalescedMisses() const {
+        return loads.coalescedCount();
+    }
 
     // Add a file to the filesystem
     void addFile(const string& name, const string& content) {
-        fs.addFile(name, content);
+        fs->addFile(name, content);
     }
 
-    // Read a file's content
+    // Read a file's content. A failed or timed out load throws, in every thread waiting on it.
     string readFile(const string& name) {
-        auto start = chrono::high_resolution_clock::now();
-        optimizer.recordAccess(name);
-        if (cache.isCached(name)) {
-            // Cache hit: access time is minimal (e.g., 1 ms)
-            File file = cache.get(name);
-            auto end = chrono::high_resolution_clock::now();
-            double accessTime = 1.0; // in milliseconds
-            metrics.updateMetrics(true, accessTime);
-            cout << "Cache hit for file '" << name << "'. Access Time: " << accessTime << " ms\n";
-            return file.content;
-        } else {
-            // Cache miss: access time includes disk I/O (e.g., 100 ms)
-            string content = fs.readFile(name);
-            if (!content.empty()) {
-                File file(name, content);
-                cache.put(file);
+        return string(readFileView(name).view());
+    }
+
+    // Zero-copy read: the handle pins the content, which stays valid even if the file is
+    // evicted or rewritten meanwhile. Invalid if the file does not exist.
+    FileHandle readFileView(const string& name) {
+        auto start = chrono::steady_clock::now();
+        {
+            lock_guard<mutex> guard(stateLock);
+            optimizer.recordAccess(name);
+            FileHandle cached = cache.get(name);
+            if (cached.valid()) {
+                uint64_t accessTime = elapsedNanos(start);
+                metrics.updateMetrics(true, PerformanceMetrics::Hit, accessTime);
+                cout << "Cache hit for file '" << name << "'. Access Time: " << accessTime << " ns\n";
+                return cached;
             }
-            auto end = chrono::high_resolution_clock::now();
-            double accessTime = 100.0; // in milliseconds
-            metrics.updateMetrics(false, accessTime);
-            cout << "Cache miss for file '" << name << "'. Access Time: " << accessTime << " ms\n";
-            return content;
         }
+
+        // Cache miss: access time includes the backing store read
+        FileHandle content = load(name);
+        uint64_t accessTime = elapsedNanos(start);
+        {
+            lock_guard<mutex> guard(stateLock);
+            metrics.updateMetrics(false, PerformanceMetrics::Miss, accessTime);
+        }
+        cout << "Cache miss for file '" << name << "'. Access Time: " << accessTime << " ns\n";
+        return content;
+    }
+
+    // Read up to `length` bytes from `offset` (fewer at the end of the file). With the block
+    // cache enabled, cached blocks are copied out and each run of missing blocks is fetched
+    // with one backing store read; otherwise the range is cut from the whole cached file.
+    string read(const string& name, size_t offset, size_t length) {
+        if (length == 0) return "";
+        bool blockCacheEnabled;
+        {
+            lock_guard<mutex> guard(stateLock);
+            blockCacheEnabled = blocks != nullptr;
+        }
+        if (!blockCacheEnabled) {
+            FileHandle content = readFileView(name);
+            return offset < content.size() ? string(content.view().substr(offset, length)) : "";
+        }
+        auto start = chrono::steady_clock::now();
+        size_t blockSize;
+        uint64_t first, count, version;
+        vector<string> parts;
+        vector<bool> cached;
+        size_t end;  // Blocks from here on are past the end of the file
+        ReadaheadDetector::Range ahead;
+        {
+            unique_lock<mutex> guard(stateLock);
+            optimizer.recordAccess(name);
+            if (readahead) {
+                ahead = readahead->onRead(name, offset, length);
+                readaheadDone.wait(guard, [&] { return !readingAheadOver(name, offset, length); });
+            }
+            blockSize = blocks->blockSize();
+            first = offset / blockSize;
+            count = (offset + length - 1) / blockSize - first + 1;
+            parts.resize(count);
+            cached.resize(count);
+            end = count;
+            for (size_t i = 0; i < count; ++i) {
+                if (const string* block = blocks->find(name, first + i)) {
+                    parts[i] = *block;
+                    cached[i] = true;
+                    if (block->size() < blockSize) {
+                        end = i + 1;
+                        break;
+                    }
+                }
+            }
+            version = blocks->version();
+        }
+
+        // Queue the readahead first, so it overlaps with this read's own misses
+        if (ahead.length > 0) {
+            {
+                lock_guard<mutex> guard(readaheadLock);
+                if (readaheadQueue.size() >= maxQueuedReadaheads && !readaheadQueue.empty()) {
+                    readaheadQueue.pop_front();
+                    droppedReadaheads++;
+                }
+                readaheadQueue.emplace_back(name, ahead);
+            }
+            readaheadWakeup.notify_one();
+        }
+
+        // Fetch each run of missing blocks in one read, outside the lock
+        vector<uint64_t> loaded;
+        loadBlocks(name, first, blockSize, parts, cached, end, loaded);
+
+        string result;
+        for (size_t i = 0; i < end; ++i) {
+            size_t blockStart = (first + i) * blockSize;
+            size_t from = i == 0 ? offset - blockStart : 0;
+            if (from >= parts[i].size()) break;
+            result.append(parts[i], from, min(parts[i].size(), offset + length - blockStart) - from);
+        }
+
+        uint64_t accessTime = elapsedNanos(start);
+        bool hit = loaded.empty() && end == count;
+        {
+            lock_guard<mutex> guard(stateLock);
+            if (blocks->version() == version) {
+                for (size_t i : loaded) {
+                    blocks->insert(name, first + i, std::move(parts[i]));
+                }
+            }
+            metrics.updateMetrics(hit, hit ? PerformanceMetrics::Hit : PerformanceMetrics::Miss, accessTime);
+        }
+        cout << "Cache " << (hit ? "hit" : "miss") << " for " << length << " bytes at " << offset << " of file '"
+             << name << "' (" << loaded.size() << " blocks loaded). Access Time: " << accessTime << " ns\n";
+        return result;
     }
 
     // Write content to a file
     void writeFile(const string& name, const string& content) {
-        auto start = chrono::high_resolution_clock::now();
-        fs.writeFile(name, content);
+        auto start = chrono::steady_clock::now();
+        fs->writeFile(name, content);
+        lock_guard<mutex> guard(stateLock);
+        // A load that started before this write may have read the old content
+        loads.invalidate(name);
+        if (blocks) blocks->invalidate(name);
         optimizer.recordAccess(name);
-        bool hit = false;
-        double accessTime = 0.0;
-        if (cache.isCached(name)) {
+        bool hit = cache.isCached(name);
+        if (hit) {
             // Update cache entry
             File file(name, content);
             cache.put(file);
-            hit = true;
-            accessTime = 1.0; // cache write is fast
-            cout << "Updated file '" << name << "' in cache. Access Time: " << accessTime << " ms\n";
+        }
+        uint64_t accessTime = elapsedNanos(start);
+        if (hit) {
+            cout << "Updated file '" << name << "' in cache. Access Time: " << accessTime << " ns\n";
         } else {
-            // Cache miss on write
-            accessTime = 100.0; // writing to disk
-            cout << "File '" << name << "' not in cache. Write to disk. Access Time: " << accessTime << " ms\n";
+            cout << "File '" << name << "' not in cache. Write to disk. Access Time: " << accessTime << " ns\n";
         }
-        metrics.updateMetrics(hit, accessTime);
+        metrics.updateMetrics(hit, PerformanceMetrics::Write, accessTime);
     }
 
     // List all files
     void listFiles() const {
-        fs.listFiles();
+        fs->listFiles();
     }
 
     // Optimize cache based on access patterns
     void optimizeCache(int topN) {
-        vector<string> topFiles = optimizer.getTopN(topN);
+        vector<string> topFiles;
+        {
+            lock_guard<mutex> guard(stateLock);
+            topFiles = optimizer.getTopN(topN);
+            optimizer.reset();
+        }
         cout << "Optimizing cache with top " << topN << " frequently accessed files.\n";
         for (const string& name : topFiles) {
-            if (!cache.isCached(name)) {
-                string content = fs.readFile(name);
-                if (!content.empty()) {
-                    File file(name, content);
-                    cache.put(file);
-                }
+            bool cached;
+            {
+                lock_guard<mutex> guard(stateLock);
+                cached = cache.isCached(name);
+            }
+            if (!cached) {
+                load(name);
             }
         }
-        optimizer.reset();
     }
 
     // Display cache contents
     void displayCache() const {
+        lock_guard<mutex> guard(stateLock);
         cache.displayCache();
     }
 
     // Display performance metrics
     void displayPerformanceMetrics() const {
-        metrics.display();
+        lock_guard<mutex> guard(stateLock);
+        PerformanceMetrics combined = metrics;
+        combined.latencies[PerformanceMetrics::Eviction].merge(cache.evictionLatencies());
+        combined.display();
+        cache.displayAdmissionStats();
+        cache.displaySlabStats();
+        cache.displayCapacityEstimates();
+        if (governor || budgetFraction < 1.0) {
+            cout << "Budget           : " << budgetFraction * 100 << "% of configured (" << cache.capacityBytes()
+                 << " / " << fullCapacity << " bytes)";
+            if (governor) {
+                cout << " | Governor stage " << governor->stage() << ", shrinks / grows: " << governor->shrinkCount()
+                     << " / " << governor->growCount();
+            }
+            cout << "\n";
+        }
+        if (blocks) blocks->displayStats();
+        if (readahead) {
+            readahead->displayStats();
+            lock_guard<mutex> queueGuard(readaheadLock);
+            cout << "Readaheads dropped from a full queue: " << droppedReadaheads << "\n";
+        }
+        cout << "Evicted while pinned by readers: " << cache.evictedWhilePinned() << "\n";
+        cout << "Backing store loads: " << loads.loadCount() << " | Coalesced misses: " << loads.coalescedCount()
+             << " | Timeouts: " << loads.timeoutCount() << " | Failed loads: " << loads.failureCount() << "\n";
+    }
+};
+
+// In-memory filesystem whose reads can be held until released, or made to fail, so the demo
+// can line up concurrent misses on one file
+class GatedFileSystem : public FileSystem {
+private:
+    mutex gate;
+    condition_variable opened;
+    bool open = true;
+    bool failing = false;
+    atomic<int> reads{0};
+
+public:
+    string readFile(const string& name) override {
+        reads++;
+        {
+            unique_lock<mutex> guard(gate);
+            opened.wait(guard, [this] { return open; });
+            if (failing) throw runtime_error("I/O error reading '" + name + "'");
+        }
+        return FileSystem::readFile(name);
+    }
+
+    // Reads wait from now until release(), then fail if `fail`
+    void hold(bool fail = false) {
+        lock_guard<mutex> guard(gate);
+        open = false;
+        failing = fail;
+    }
+
+    void release() {
+        {
+            lock_guard<mutex> guard(gate);
+            open = true;
+        }
+        opened.notify_all();
+    }
+
+    int readCount() const {
+        return reads;
     }
 };
 
 // Main function to demonstrate the filesystem with cache optimizer
-int main() {
-    // Initialize FileSystemCacheOptimizer with cache capacity of 3 files
-    FileSystemCacheOptimizer fsCacheOpt(3);
+// Usage: FileSystemCacheOptimizer [directory [--direct]]
+// With a directory the files live on disk there (optionally O_DIRECT), otherwise in memory.
+int main(int argc, char* argv[]) {
+    unique_ptr<StorageBackend> backend;
+    if (argc > 1) {
+        bool direct = argc > 2 && string(argv[2]) == "--direct";
+        backend = make_unique<PosixFileSystem>(argv[1], direct);
+    }
+
+    // Initialize FileSystemCacheOptimizer with a 90 byte budget (about three of the files below)
+    FileSystemCacheOptimizer fsCacheOpt(90, 0.5, std::move(backend));
+    fsCacheOpt.enableCapacityEstimates(30, 2);  // What one file's worth more or less would change
 
     // Add files to the filesystem
     fsCacheOpt.addFile("file1.txt", "This is the content of file1.");
@@ -379,6 +1925,99 @@ int main() {
     fsCacheOpt.writeFile("file3.txt", "Updated content of file3."); // Update and cache
     fsCacheOpt.readFile("file3.txt"); // Cache hit
 
+    // Byte-range reads through the block cache: only the blocks a read touches are loaded
+    cout << "\n--- Block Reads ---\n";
+    fsCacheOpt.enableBlockCache(64, 16);
+    fsCacheOpt.addFile("large.txt", "0123456789abcdef0123456789ABCDEF0123456789abcdef0123456789ABCDEF0123");
+    fsCacheOpt.read("large.txt", 20, 8);   // Miss: loads block 1
+    fsCacheOpt.read("large.txt", 18, 10);  // Hit: same block
+    fsCacheOpt.read("large.txt", 24, 40);  // Miss: loads blocks 2-3 in one read, block 1 cached
+    fsCacheOpt.read("large.txt", 60, 20);  // Miss: block 4 is the short last block
+
+    // The memory governor, driven by fake PSI and cgroup files: rising pressure shrinks the
+    // budget in stages and it grows back once pressure clears
+    cout << "\n--- Memory Pressure ---\n";
+    filesystem::path fake = filesystem::temp_directory_path() / "fscache-governor";
+    filesystem::create_directories(fake);
+    auto writeFake = [&](const string& file, const string& text) { ofstream(fake / file) << text; };
+    MemoryGovernorOptions governorOptions;
+    governorOptions.pressurePath = (fake / "pressure").string();
+    governorOptions.cgroupPath = fake.string();
+    governorOptions.settlePolls = 0;
+    governorOptions.calmPolls = 1;
+    MemoryGovernor governor(governorOptions, [&](double fraction, int stage) {
+        cout << "Memory governor: stage " << stage << ", budget at " << fraction * 100 << "%\n";
+        fsCacheOpt.setBudgetFraction(fraction);
+    });
+    writeFake("memory.max", "1000000\n");
+    writeFake("memory.current", "500000\n");
+    writeFake("pressure", "some avg10=25.00 avg60=8.00 avg300=2.00 total=1000\nfull avg10=0.00 avg60=0.00 avg300=0.00 total=0\n");
+    governor.poll();  // Stalls on memory: one stage down
+    writeFake("memory.current", "990000\n");
+    governor.poll();  // Almost at the cgroup limit: straight to the last stage
+    fsCacheOpt.displayCache();
+    writeFake("memory.current", "500000\n");
+    writeFake("pressure", "some avg10=0.00 avg60=0.00 avg300=0.00 total=1000\nfull avg10=0.00 avg60=0.00 avg300=0.00 total=0\n");
+    governor.poll();  // Calm again: one stage back per calm period
+    filesystem::remove_all(fake);
+
+    // Concurrent misses on one file: a single backing store read, whose content or exception
+    // every reader gets, while readers past the load timeout give up on their own
+    cout << "\n--- Concurrent Misses ---\n";
+    auto gated = make_unique<GatedFileSystem>();
+    GatedFileSystem& disk = *gated;
+    FileSystemCacheOptimizer shared(90, 0.5, std::move(gated));
+    shared.addFile("shared.txt", "Read by several threads at once.");
+    shared.addFile("broken.txt", "Never read: the disk fails.");
+    shared.addFile("slow.txt", "Read by the one thread that waited.");
+    const int readers = 8;
+    atomic<int> finished{0};
+    // Starts the readers with the backing store held, and releases it once `ready`
+    auto readAll = [&](const string& name, const function<bool()>& ready, bool fail) {
+        vector<string> results(readers);
+        vector<thread> threads;
+        finished = 0;
+        disk.hold(fail);
+        for (int i = 0; i < readers; ++i) {
+            threads.emplace_back([&, i] {
+                try {
+                    results[i] = shared.readFile(name);
+                } catch (const exception& e) {
+                    results[i] = string("error: ") + e.what();
+                }
+                finished++;
+            });
+        }
+        while (!ready()) this_thread::sleep_for(chrono::milliseconds(1));
+        disk.release();
+        for (auto& reader : threads) reader.join();
+        return results;
+    };
+    auto countOf = [](const vector<string>& results, const string& prefix) {
+        return count_if(results.begin(), results.end(), [&](const string& r) { return r.rfind(prefix, 0) == 0; });
+    };
+
+    // Released once every reader but the leader waits on its load
+    long long waited = shared.coalescedMisses();
+    vector<string> results = readAll("shared.txt", [&] { return shared.coalescedMisses() == waited + readers - 1; }, false);
+    cout << readers << " readers: " << disk.readCount() << " backing store read, "
+         << countOf(results, "Read by several") << " got the file\n";
+    assert(disk.readCount() == 1 && countOf(results, "Read by several") == readers);
+
+    waited = shared.coalescedMisses();
+    results = readAll("broken.txt", [&] { return shared.coalescedMisses() == waited + readers - 1; }, true);
+    cout << readers << " readers of a failing file: " << disk.readCount() - 1 << " backing store read, "
+         << countOf(results, "error: I/O error") << " saw its error\n";
+    assert(disk.readCount() == 2 && countOf(results, "error: I/O error") == readers);
+
+    shared.setLoadTimeout(chrono::milliseconds(20));
+    results = readAll("slow.txt", [&] { return finished == readers - 1; }, false);
+    cout << readers << " readers with a 20 ms timeout: " << countOf(results, "error: timed out")
+         << " timed out, " << countOf(results, "Read by the one") << " got the file\n";
+    assert(disk.readCount() == 3 && countOf(results, "error: timed out") == readers - 1 &&
+           countOf(results, "Read by the one") == 1);
+    shared.setLoadTimeout(chrono::milliseconds(0));
+
     cout << "\nFinal Cache state:\n";
     fsCacheOpt.displayCache();
 
@@ -386,4 +2025,4 @@ int main() {
     fsCacheOpt.displayPerformanceMetrics();
 
     return 0;
-}
\ No newline at end of file
+}
\ No newline at end of file
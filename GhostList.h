@@ -0,0 +1,206 @@
+#ifndef GHOST_LIST_H
+#define GHOST_LIST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// What-if estimates for resizing a cache, in the cache's own capacity unit (bytes or entries).
+struct CapacityEstimate {
+    size_t step = 0;                   // Capacity change the counts below are per
+    std::vector<long long> extraHits;  // [i]: misses a cache (i + 1) steps larger would have hit
+    long long lostHits = -1;           // Hits a cache one step smaller would have missed; -1 if not tracked
+    long long accesses = 0;
+
+    void print(std::ostream &out, const char *unit) const {
+        long long cumulative = 0;
+        for (size_t i = 0; i < extraHits.size(); ++i) {
+            cumulative += extraHits[i];
+            out << "  +" << (i + 1) * step << " " << unit << ": " << cumulative << " extra hits ("
+                << (accesses ? 100.0 * cumulative / accesses : 0.0) << "% of accesses)\n";
+        }
+        if (lostHits >= 0) {
+            out << "  -" << step << " " << unit << ": " << lostHits << " lost hits ("
+                << (accesses ? 100.0 * lostHits / accesses : 0.0) << "% of accesses)\n";
+        }
+    }
+};
+
+// Keys (no content) of the entries evicted most recently, up to `steps` steps of evicted
+// weight. A miss on a ghost key would have been a hit in a cache larger by the weight
+// evicted since that key left, which is counted in extraHits per step. Not thread-safe.
+class GhostList {
+public:
+    GhostList(size_t step, int steps)
+        : step(step > 0 ? step : 1), limit(this->step * (steps > 0 ? steps : 1)),
+          ghostWeight(0), evictedWeight(0), hits(steps > 0 ? steps : 1, 0) {}
+
+    void evicted(const std::string &key, size_t weight) {
+        forget(key);
+        ghosts.push_front({key, weight, evictedWeight});
+        index[key] = ghosts.begin();
+        ghostWeight += weight;
+        evictedWeight += weight;
+        while (ghostWeight > limit) {
+            ghostWeight -= ghosts.back().weight;
+            index.erase(ghosts.back().key);
+            ghosts.pop_back();
+        }
+    }
+
+    // Call on a miss; true if the key was a ghost
+    bool missed(const std::string &key) {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return false;
+        }
+        uint64_t needed = evictedWeight - it->second->evictedBefore;  // Includes the key's own weight
+        size_t bucket = needed ? static_cast<size_t>((needed - 1) / step) : 0;
+        if (bucket < hits.size()) {
+            hits[bucket]++;
+        }
+        remove(it);
+        return true;
+    }
+
+    // The key is cached again, or gone for a reason other than eviction
+    void forget(const std::string &key) {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            remove(it);
+        }
+    }
+
+    size_t stepSize() const {
+        return step;
+    }
+
+    const std::vector<long long> &extraHits() const {
+        return hits;
+    }
+
+    size_t size() const {
+        return ghosts.size();
+    }
+
+private:
+    struct Ghost {
+        std::string key;
+        size_t weight;
+        uint64_t evictedBefore;  // evictedWeight when this key was evicted
+    };
+
+    size_t step;
+    size_t limit;
+    size_t ghostWeight;
+    uint64_t evictedWeight;  // Total ever evicted
+    std::list<Ghost> ghosts;  // Most recently evicted first
+    std::unordered_map<std::string, std::list<Ghost>::iterator> index;
+    std::vector<long long> hits;
+
+    void remove(std::unordered_map<std::string, std::list<Ghost>::iterator>::iterator it) {
+        ghostWeight -= it->second->weight;
+        ghosts.erase(it->second);
+        index.erase(it);
+    }
+};
+
+// Shadow counter for a smaller cache. The resident keys are kept in recency order, and
+// those past the first `smallerCapacity` of weight are marked as the tail: a hit there
+// would have been a miss in a cache of smallerCapacity that evicted in recency order. For
+// caches that evict by frequency this is an approximation. Not thread-safe.
+class ShadowTier {
+public:
+    explicit ShadowTier(size_t smallerCapacity)
+        : smallerCapacity(smallerCapacity), headWeight(0), lost(0), boundary(order.end()) {}
+
+    void inserted(const std::string &key, size_t weight) {
+        removed(key);
+        order.push_front({key, weight, false});
+        index[key] = order.begin();
+        headWeight += weight;
+        rebalance();
+    }
+
+    void hit(const std::string &key) {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return;
+        }
+        Position position = it->second;
+        if (position->inTail) {
+            lost++;
+        }
+        detach(position);
+        order.splice(order.begin(), order, position);
+        position->inTail = false;
+        headWeight += position->weight;
+        rebalance();
+    }
+
+    void removed(const std::string &key) {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return;
+        }
+        detach(it->second);
+        order.erase(it->second);
+        index.erase(it);
+        rebalance();
+    }
+
+    // The cache's budget moved: compare against a cache one step below the new one
+    void resize(size_t smallerCapacity) {
+        this->smallerCapacity = smallerCapacity;
+        rebalance();
+    }
+
+    long long lostHits() const {
+        return lost;
+    }
+
+private:
+    struct Resident {
+        std::string key;
+        size_t weight;
+        bool inTail;
+    };
+    using Position = std::list<Resident>::iterator;
+
+    size_t smallerCapacity;
+    size_t headWeight;  // Weight before the boundary, which the smaller cache would hold
+    long long lost;
+    std::list<Resident> order;  // Most recent first; the tail runs from boundary to the end
+    Position boundary;
+    std::unordered_map<std::string, Position> index;
+
+    // Takes an entry out of the head or tail accounting, before it moves or goes
+    void detach(Position position) {
+        if (boundary == position) {
+            ++boundary;
+        }
+        if (!position->inTail) {
+            headWeight -= position->weight;
+        }
+    }
+
+    // Move the boundary so the head is the longest recency prefix within smallerCapacity
+    void rebalance() {
+        while (headWeight > smallerCapacity && boundary != order.begin()) {
+            --boundary;
+            boundary->inTail = true;
+            headWeight -= boundary->weight;
+        }
+        while (boundary != order.end() && headWeight + boundary->weight <= smallerCapacity) {
+            boundary->inTail = false;
+            headWeight += boundary->weight;
+            ++boundary;
+        }
+    }
+};
+
+#endif // GHOST_LIST_H
@@ -0,0 +1,84 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// Log-bucketed histogram in the style of HdrHistogram, meant for nanosecond latencies.
+// Values below 64 get a bucket each; above that every power of two is split into 32
+// linear sub-buckets, so a percentile is reported within 1/32 (about 3%) of the true
+// value at any magnitude. Recording is a handful of integer operations, and histograms
+// filled by different threads can be merged afterwards.
+class LatencyHistogram {
+public:
+    void record(uint64_t value) {
+        counts[indexOf(value)]++;
+        total++;
+        sum += value;
+        if (value < minValue) minValue = value;
+        if (value > maxValue) maxValue = value;
+    }
+
+    void merge(const LatencyHistogram &other) {
+        for (int i = 0; i < bucketCount; ++i) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        sum += other.sum;
+        if (other.minValue < minValue) minValue = other.minValue;
+        if (other.maxValue > maxValue) maxValue = other.maxValue;
+    }
+
+    void reset() {
+        *this = LatencyHistogram();
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? minValue : 0; }
+    uint64_t max() const { return maxValue; }
+    double mean() const { return total ? (double)sum / total : 0.0; }
+
+    // Smallest bucket bound that at least a fraction q of the values fall under; q = 1 gives max()
+    uint64_t percentile(double q) const {
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(std::ceil(q * total));
+        if (rank == 0) rank = 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < bucketCount; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                uint64_t bound = upperBound(i);
+                return bound < maxValue ? bound : maxValue;
+            }
+        }
+        return maxValue;
+    }
+
+private:
+    static constexpr int subBucketBits = 5;
+    static constexpr int subBucketCount = 1 << subBucketBits;
+    static constexpr int bucketCount = (65 - subBucketBits) * subBucketCount;
+
+    std::array<uint64_t, bucketCount> counts{};
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t minValue = std::numeric_limits<uint64_t>::max();
+    uint64_t maxValue = 0;
+
+    // Group g holds values whose top bit is subBucketBits + g, at a resolution of 2^g
+    static int indexOf(uint64_t value) {
+        int topBit = 63 - __builtin_clzll(value | 1);
+        int group = topBit > subBucketBits ? topBit - subBucketBits : 0;
+        return group * subBucketCount + static_cast<int>(value >> group);
+    }
+
+    static uint64_t upperBound(int index) {
+        int group = index < 2 * subBucketCount ? 0 : (index >> subBucketBits) - 1;
+        uint64_t sub = index - group * subBucketCount;
+        return ((sub + 1) << group) - 1;
+    }
+};
+
+#endif // LATENCY_HISTOGRAM_H
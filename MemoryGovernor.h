@@ -0,0 +1,237 @@
+#ifndef MEMORY_GOVERNOR_H
+#define MEMORY_GOVERNOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct MemoryGovernorOptions {
+    std::string pressurePath = "/proc/pressure/memory";
+    std::string cgroupPath;  // Holds memory.current, memory.max and memory.stat; empty: this process's cgroup
+    std::chrono::milliseconds interval{1000};  // Between polls of the background thread
+    double highPressure = 10;     // PSI "some" avg10 (% of time stalled) that shrinks one stage
+    double criticalPressure = 5;  // PSI "full" avg10 that goes to the last stage at once
+    double lowPressure = 1;       // "some" avg10 below which the budget may grow back
+    double highUsage = 0.90;      // cgroup working set over memory.max that shrinks one stage
+    double criticalUsage = 0.97;
+    double lowUsage = 0.80;
+    std::vector<double> stages = {1.0, 0.75, 0.5, 0.25};  // Fraction of the full budget per stage
+    int settlePolls = 3;          // Polls after a shrink before the next one, unless critical
+    int calmPolls = 10;           // Consecutive calm polls before growing back one stage
+};
+
+// One reading of the pressure and cgroup files. Sources that are missing (no PSI, cgroup
+// v1, or memory.max of "max") are left unset and do not count towards any decision.
+struct MemoryReading {
+    bool hasPressure = false;
+    double someAvg10 = 0;
+    double fullAvg10 = 0;
+    bool hasLimit = false;
+    uint64_t current = 0;
+    uint64_t limit = 0;
+    uint64_t inactiveFile = 0;  // Page cache the kernel can drop without pressure
+
+    // Working set over the limit, as the kernel's OOM handling sees it; 0 without a limit
+    double usage() const {
+        if (!hasLimit || limit == 0) return 0;
+        return static_cast<double>(current - std::min(current, inactiveFile)) / limit;
+    }
+};
+
+// Shrinks a cache's budget in stages as memory pressure rises, and grows it back when it
+// clears, so the cache gives memory back before the cgroup limit OOM-kills the process.
+//
+// Each poll reads the PSI file (/proc/pressure/memory) and the cgroup v2 memory.current,
+// memory.max and memory.stat, then moves one stage down on high pressure or usage, to the
+// last stage on critical pressure or usage, and one stage up after calmPolls calm polls in
+// a row. PSI averages trail the eviction that relieves them, so after a shrink the next
+// one waits settlePolls polls. `apply` is called with the new stage's budget fraction
+// whenever the stage changes, on the polling thread; it is where the cache evicts, off its
+// readers' path. The paths can point at ordinary files, to drive the governor in tests.
+class MemoryGovernor {
+public:
+    using Apply = std::function<void(double fraction, int stage)>;
+
+    MemoryGovernor(MemoryGovernorOptions options, Apply apply)
+        : options(std::move(options)), apply(std::move(apply)), current(0), settle(0), calm(0), shrinks(0), grows(0) {
+        if (this->options.stages.empty()) this->options.stages = {1.0};
+        if (this->options.cgroupPath.empty()) this->options.cgroupPath = ownCgroup();
+    }
+
+    ~MemoryGovernor() {
+        stop();
+    }
+
+    MemoryGovernor(const MemoryGovernor &) = delete;
+    MemoryGovernor &operator=(const MemoryGovernor &) = delete;
+
+    // Polls every interval on a background thread until stop()
+    void start() {
+        if (poller.joinable()) return;
+        stopping = false;
+        poller = std::thread([this] {
+            std::unique_lock<std::mutex> guard(lock);
+            while (!wakeup.wait_for(guard, options.interval, [this] { return stopping; })) {
+                guard.unlock();
+                poll();
+                guard.lock();
+            }
+        });
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        if (poller.joinable()) poller.join();
+    }
+
+    // Reads the files once and moves the stage; returns the stage now in effect
+    int poll() {
+        MemoryReading reading = read();
+        int last = static_cast<int>(options.stages.size()) - 1;
+        int stage = current;
+        bool critical = (reading.hasPressure && reading.fullAvg10 >= options.criticalPressure) ||
+                        (reading.hasLimit && reading.usage() >= options.criticalUsage);
+        bool high = (reading.hasPressure && reading.someAvg10 >= options.highPressure) ||
+                    (reading.hasLimit && reading.usage() >= options.highUsage);
+        bool quiet = (!reading.hasPressure || reading.someAvg10 < options.lowPressure) &&
+                     (!reading.hasLimit || reading.usage() < options.lowUsage);
+
+        if (settle > 0) settle--;
+        calm = quiet ? calm + 1 : 0;
+        if (critical) {
+            stage = last;
+        } else if (high && settle == 0) {
+            stage = std::min(stage + 1, last);
+        } else if (calm >= options.calmPolls && stage > 0) {
+            stage--;
+        }
+        if (stage != current) {
+            if (stage > current) {
+                shrinks++;
+                settle = options.settlePolls;
+            } else {
+                grows++;
+            }
+            calm = 0;
+            current = stage;
+            if (apply) apply(options.stages[stage], stage);
+        }
+        return stage;
+    }
+
+    MemoryReading read() const {
+        MemoryReading reading;
+        std::string text;
+        if (readFile(options.pressurePath, text)) {
+            reading.hasPressure = parsePressure(text, reading.someAvg10, reading.fullAvg10);
+        }
+        std::string limit;
+        if (readFile(options.cgroupPath + "/memory.max", limit) && readFile(options.cgroupPath + "/memory.current", text)) {
+            try {
+                reading.limit = std::stoull(limit);  // Throws on "max"
+                reading.current = std::stoull(text);
+                reading.hasLimit = true;
+            } catch (const std::exception &) {
+                reading.hasLimit = false;
+            }
+        }
+        if (reading.hasLimit && readFile(options.cgroupPath + "/memory.stat", text)) {
+            std::istringstream stat(text);
+            std::string key;
+            uint64_t value;
+            while (stat >> key >> value) {
+                if (key == "inactive_file") reading.inactiveFile = value;
+            }
+        }
+        return reading;
+    }
+
+    int stage() const {
+        return current;
+    }
+
+    double fraction() const {
+        return options.stages[current];
+    }
+
+    long long shrinkCount() const {
+        return shrinks;
+    }
+
+    long long growCount() const {
+        return grows;
+    }
+
+    // The avg10 values of the "some" and "full" lines of a PSI file
+    static bool parsePressure(const std::string &text, double &some, double &full) {
+        std::istringstream lines(text);
+        std::string line;
+        bool found = false;
+        while (std::getline(lines, line)) {
+            size_t at = line.find("avg10=");
+            if (at == std::string::npos) continue;
+            double value = std::strtod(line.c_str() + at + 6, nullptr);
+            if (line.compare(0, 4, "some") == 0) {
+                some = value;
+                found = true;
+            } else if (line.compare(0, 4, "full") == 0) {
+                full = value;
+            }
+        }
+        return found;
+    }
+
+private:
+    MemoryGovernorOptions options;
+    Apply apply;
+    std::atomic<int> current;  // Written by the polling thread only
+    int settle;
+    int calm;
+    std::atomic<long long> shrinks;
+    std::atomic<long long> grows;
+
+    std::thread poller;
+    std::mutex lock;
+    std::condition_variable wakeup;
+    bool stopping = false;
+
+    static bool readFile(const std::string &path, std::string &text) {
+        std::ifstream in(path);
+        if (!in) return false;
+        std::ostringstream buffer;
+        buffer << in.rdbuf();
+        text = buffer.str();
+        return true;
+    }
+
+    // The cgroup v2 directory of this process, from its "0::/path" line in /proc/self/cgroup
+    static std::string ownCgroup() {
+        std::string text;
+        if (readFile("/proc/self/cgroup", text)) {
+            std::istringstream lines(text);
+            std::string line;
+            while (std::getline(lines, line)) {
+                if (line.compare(0, 3, "0::") == 0) {
+                    std::string path = line.substr(3);
+                    return "/sys/fs/cgroup" + (path == "/" ? "" : path);
+                }
+            }
+        }
+        return "/sys/fs/cgroup";
+    }
+};
+
+#endif // MEMORY_GOVERNOR_H
@@ -0,0 +1,298 @@
+#ifndef SLAB_ALLOCATOR_H
+#define SLAB_ALLOCATOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Size-class slab allocator in the style of memcached, for cached file contents.
+//
+// Memory is reserved in pages of pageSize bytes (a power of two), at most memoryLimit in
+// total. Every page belongs to one size class and is cut into equal chunks; class sizes
+// grow by growthFactor from minChunk up to a whole page. An allocation takes a chunk from
+// the smallest class that fits, so waste is bounded by the growth factor and freed chunks
+// are reused as they are instead of fragmenting the heap. Requests larger than a page, or
+// that would exceed the limit, get nullptr. The cache keeps files larger than a page on the
+// heap, but a file refused for the limit is not cached unless evicting from its own class
+// makes room, so memory stays within the limit.
+//
+// A page whose chunks are all free can be handed to another class. With autoRebalance
+// this happens whenever a class is out of chunks and no page can be added; rebalance()
+// does it on demand for the class that was refused most often. Thread-safe.
+class SlabAllocator {
+public:
+    struct ClassStats {
+        size_t chunkSize;
+        size_t pages;
+        size_t chunksUsed;
+        size_t chunksTotal;
+        size_t requestedBytes;  // Bytes asked for by the live allocations
+        size_t failures;        // Allocations refused for lack of memory
+    };
+
+    explicit SlabAllocator(size_t memoryLimit, size_t pageSize = 1 << 20, double growthFactor = 1.25,
+                           size_t minChunk = 64, bool autoRebalance = true)
+        : pageSize(roundUpToPowerOfTwo(std::max<size_t>(pageSize, 4096))), autoRebalance(autoRebalance) {
+        // A partial page cannot be used, and one page is the least that can be
+        limit = std::max(this->pageSize, (memoryLimit + this->pageSize - 1) / this->pageSize * this->pageSize);
+        growthFactor = std::max(growthFactor, 1.01);
+        size_t size = std::max<size_t>(minChunk, sizeof(void *));
+        while (size <= this->pageSize / 2) {
+            classes.push_back(SizeClass{roundUp8(size)});
+            size = std::max(roundUp8(size) + 8, static_cast<size_t>(size * growthFactor));
+        }
+        classes.push_back(SizeClass{this->pageSize});
+    }
+
+    ~SlabAllocator() {
+        for (auto &page : pages) {
+            std::free(page.first);
+        }
+    }
+
+    SlabAllocator(const SlabAllocator &) = delete;
+    SlabAllocator &operator=(const SlabAllocator &) = delete;
+
+    void *allocate(size_t bytes) {
+        std::lock_guard<std::mutex> guard(lock);
+        int index = classFor(bytes);
+        if (index < 0) {
+            return nullptr;
+        }
+        SizeClass &cls = classes[index];
+        if (!cls.freeList && !addPage(index) && !(autoRebalance && reassignFreePage(index))) {
+            cls.failures++;
+            cls.failuresSinceRebalance++;
+            return nullptr;
+        }
+
+        FreeChunk *chunk = cls.freeList;
+        cls.freeList = chunk->next;
+        cls.used++;
+        cls.requested += bytes;
+        pageOf(chunk).used++;
+        return chunk;
+    }
+
+    void deallocate(void *pointer, size_t bytes) {
+        std::lock_guard<std::mutex> guard(lock);
+        Page &page = pageOf(pointer);
+        SizeClass &cls = classes[page.sizeClass];
+        FreeChunk *chunk = static_cast<FreeChunk *>(pointer);
+        chunk->next = cls.freeList;
+        cls.freeList = chunk;
+        cls.used--;
+        cls.requested -= bytes;
+        page.used--;
+    }
+
+    // What an allocation of `bytes` really occupies; 0 if it is larger than a page
+    size_t chunkSize(size_t bytes) const {
+        int index = classFor(bytes);
+        return index < 0 ? 0 : classes[index].chunkSize;
+    }
+
+    // Moves one completely free page to the class refused most often since the last call
+    bool rebalance() {
+        std::lock_guard<std::mutex> guard(lock);
+        int neediest = -1;
+        for (size_t i = 0; i < classes.size(); ++i) {
+            if (classes[i].failuresSinceRebalance > 0 &&
+                (neediest < 0 || classes[i].failuresSinceRebalance > classes[neediest].failuresSinceRebalance)) {
+                neediest = static_cast<int>(i);
+            }
+        }
+        if (neediest < 0) {
+            return false;
+        }
+        classes[neediest].failuresSinceRebalance = 0;
+        return reassignFreePage(neediest);
+    }
+
+    std::vector<ClassStats> statistics() const {
+        std::lock_guard<std::mutex> guard(lock);
+        std::vector<ClassStats> stats;
+        for (const SizeClass &cls : classes) {
+            stats.push_back({cls.chunkSize, cls.pages, cls.used, cls.pages * (pageSize / cls.chunkSize),
+                             cls.requested, cls.failures});
+        }
+        return stats;
+    }
+
+    // Moves the memory limit and frees completely free pages until the pages held fit in
+    // it; returns the bytes given back. Pages with live chunks are kept, so after a lower
+    // limit, call again once their chunks have been freed.
+    size_t setMemoryLimit(size_t memoryLimit) {
+        std::lock_guard<std::mutex> guard(lock);
+        limit = std::max(pageSize, (memoryLimit + pageSize - 1) / pageSize * pageSize);
+        size_t released = 0;
+        for (auto it = pages.begin(); it != pages.end() && pages.size() * pageSize > limit;) {
+            if (it->second.used != 0) {
+                ++it;
+                continue;
+            }
+            char *start = it->first;
+            unlinkChunks(start, classes[it->second.sizeClass]);
+            classes[it->second.sizeClass].pages--;
+            it = pages.erase(it);
+            std::free(start);
+            released += pageSize;
+        }
+        return released;
+    }
+
+    size_t memoryLimit() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return limit;
+    }
+
+    // The page with the fewest live chunks, and its chunk size: the cheapest one to empty
+    // when the pages held exceed the limit. {nullptr, 0} if no page is in use.
+    std::pair<const char *, size_t> sparsestPage() const {
+        std::lock_guard<std::mutex> guard(lock);
+        const std::pair<char *const, Page> *sparsest = nullptr;
+        for (const auto &entry : pages) {
+            if (entry.second.used != 0 && (!sparsest || entry.second.used < sparsest->second.used)) {
+                sparsest = &entry;
+            }
+        }
+        if (!sparsest) return {nullptr, 0};
+        return {sparsest->first, classes[sparsest->second.sizeClass].chunkSize};
+    }
+
+    bool onPage(const char *page, const void *pointer) const {
+        const char *at = static_cast<const char *>(pointer);
+        return at >= page && at < page + pageSize;
+    }
+
+    size_t reservedBytes() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return pages.size() * pageSize;
+    }
+
+    // Per-class utilization, only for classes that have pages or were refused
+    void printStats(std::ostream &out) const {
+        out << "Slab classes (page " << pageSize << " bytes, " << reservedBytes() << " / " << memoryLimit() << " reserved):\n";
+        out << "   Chunk   Pages      Used     Total   Used%   Fill%  Refused\n";
+        for (const ClassStats &cls : statistics()) {
+            if (cls.pages == 0 && cls.failures == 0) continue;
+            double used = cls.chunksTotal ? 100.0 * cls.chunksUsed / cls.chunksTotal : 0.0;
+            double fill = cls.chunksUsed ? 100.0 * cls.requestedBytes / (cls.chunksUsed * cls.chunkSize) : 0.0;
+            out << std::fixed << std::setprecision(1) << std::setw(8) << cls.chunkSize << std::setw(8) << cls.pages
+                << std::setw(10) << cls.chunksUsed << std::setw(10) << cls.chunksTotal << std::setw(8) << used
+                << std::setw(8) << fill << std::setw(9) << cls.failures << "\n";
+        }
+    }
+
+private:
+    struct FreeChunk {
+        FreeChunk *next;
+    };
+
+    struct SizeClass {
+        size_t chunkSize;
+        FreeChunk *freeList = nullptr;
+        size_t pages = 0;
+        size_t used = 0;
+        size_t requested = 0;
+        size_t failures = 0;
+        size_t failuresSinceRebalance = 0;
+    };
+
+    struct Page {
+        size_t sizeClass;
+        size_t used;
+    };
+
+    size_t pageSize;
+    size_t limit;
+    bool autoRebalance;
+    std::vector<SizeClass> classes;
+    std::unordered_map<char *, Page> pages;  // Keyed by page start; pages are pageSize-aligned
+    mutable std::mutex lock;
+
+    static size_t roundUp8(size_t bytes) {
+        return (bytes + 7) & ~static_cast<size_t>(7);
+    }
+
+    static size_t roundUpToPowerOfTwo(size_t bytes) {
+        size_t power = 1;
+        while (power < bytes) power <<= 1;
+        return power;
+    }
+
+    int classFor(size_t bytes) const {
+        auto it = std::lower_bound(classes.begin(), classes.end(), bytes,
+                                   [](const SizeClass &cls, size_t size) { return cls.chunkSize < size; });
+        return it == classes.end() ? -1 : static_cast<int>(it - classes.begin());
+    }
+
+    Page &pageOf(void *pointer) {
+        uintptr_t start = reinterpret_cast<uintptr_t>(pointer) & ~(static_cast<uintptr_t>(pageSize) - 1);
+        return pages.find(reinterpret_cast<char *>(start))->second;
+    }
+
+    // Cuts a page into chunks of the given class and pushes them on its free list
+    void carve(char *start, int index) {
+        SizeClass &cls = classes[index];
+        size_t count = pageSize / cls.chunkSize;
+        for (size_t i = count; i-- > 0;) {
+            FreeChunk *chunk = reinterpret_cast<FreeChunk *>(start + i * cls.chunkSize);
+            chunk->next = cls.freeList;
+            cls.freeList = chunk;
+        }
+        cls.pages++;
+        pages[start] = Page{static_cast<size_t>(index), 0};
+    }
+
+    bool addPage(int index) {
+        if ((pages.size() + 1) * pageSize > limit) {
+            return false;
+        }
+        char *start = static_cast<char *>(std::aligned_alloc(pageSize, pageSize));
+        if (!start) {
+            return false;
+        }
+        carve(start, index);
+        return true;
+    }
+
+    // Removes a page's chunks from its class's free list (rare, so a list walk is fine)
+    void unlinkChunks(char *start, SizeClass &owner) {
+        FreeChunk **link = &owner.freeList;
+        while (*link) {
+            char *chunk = reinterpret_cast<char *>(*link);
+            if (chunk >= start && chunk < start + pageSize) {
+                *link = (*link)->next;
+            } else {
+                link = &(*link)->next;
+            }
+        }
+    }
+
+    // Takes a page with no live chunks away from another class
+    bool reassignFreePage(int target) {
+        for (auto &entry : pages) {
+            if (entry.second.used != 0 || entry.second.sizeClass == static_cast<size_t>(target)) {
+                continue;
+            }
+            char *start = entry.first;
+            SizeClass &owner = classes[entry.second.sizeClass];
+            unlinkChunks(start, owner);
+            owner.pages--;
+            pages.erase(start);
+            carve(start, target);
+            return true;
+        }
+        return false;
+    }
+};
+
+#endif // SLAB_ALLOCATOR_H
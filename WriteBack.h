@@ -0,0 +1,355 @@
+#ifndef WRITE_BACK_H
+#define WRITE_BACK_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Background write-back shared by the CacheOptimizer implementations.
+//
+// A cache records its dirty entries in a DirtyTracker, oldest first. A WriteBackFlusher
+// thread wakes every `interval` and asks the cache for the entries that have been dirty
+// longer than maxAge, plus the oldest ones while unflushed data is above the high
+// watermark (down to the low watermark). The cache publishes them to its backing store
+// and the flusher hands them on, sorted by path and maxBatchEntries at a time, to a
+// writer such as WriteBackJournal that makes each batch durable with a single sync.
+// A batch whose writer throws is handed back to the cache, which marks its entries dirty
+// again with their original dirty time, so the next flush retries them.
+// Writers only block while unflushed data is at the hard limit.
+
+struct DirtyRecord {
+    std::string path;
+    std::string data;
+    std::chrono::steady_clock::time_point since{};  // When it became dirty
+    size_t trackedBytes = 0;  // Bytes it holds in the DirtyTracker's in-flight count
+};
+
+struct WriteBackOptions {
+    std::chrono::milliseconds maxAge{1000};    // Dirty data older than this is flushed
+    std::chrono::milliseconds interval{100};   // How often the flusher wakes up on its own
+    size_t highWatermarkBytes = 1 << 20;       // Above this the flusher starts immediately...
+    size_t lowWatermarkBytes = 512 << 10;      // ...and flushes down to this
+    size_t hardLimitBytes = 4 << 20;           // Writers stall while this much is unflushed
+    size_t maxBatchEntries = 64;               // Records per writer call (one sync each)
+};
+
+struct WriteBackStats {
+    long long batches = 0;
+    long long records = 0;
+    long long bytes = 0;
+    long long maxBatchRecords = 0;
+    long long flushNanos = 0;      // Time spent in the writer, summed over batches
+    long long maxFlushNanos = 0;
+    long long failures = 0;        // Batches whose writer threw
+    long long stalls = 0;          // Writes that waited at the hard limit
+    long long stallNanos = 0;
+
+    void print() const {
+        double meanBatch = batches ? (double)records / batches : 0.0;
+        double meanFlushUs = batches ? flushNanos / 1000.0 / batches : 0.0;
+        std::cout << "Write-back: " << batches << " batches, " << records << " records, " << bytes << " bytes"
+                  << " | Batch size: mean " << meanBatch << ", max " << maxBatchRecords << std::endl;
+        std::cout << "Flush latency: mean " << meanFlushUs << " us, max " << maxFlushNanos / 1000.0 << " us"
+                  << " | Failed batches: " << failures
+                  << " | Stalls: " << stalls << " (" << stallNanos / 1e6 << " ms)" << std::endl;
+    }
+};
+
+// Dirty entries in the order they first became dirty, and their total size, plus the
+// bytes taken for flushing that are not written yet. Not synchronized: the owning cache
+// calls it under its own lock. unflushed() may be read and written() called from any thread.
+class DirtyTracker {
+public:
+    using Clock = std::chrono::steady_clock;
+    struct Entry {
+        std::string path;
+        size_t bytes;
+        Clock::time_point since;
+    };
+    using Handle = std::list<Entry>::iterator;
+
+    Handle add(const std::string &path, size_t bytes) {
+        total.fetch_add(bytes, std::memory_order_relaxed);
+        return order.insert(order.end(), Entry{path, bytes, Clock::now()});
+    }
+
+    // A dirty entry was written again. It keeps its age: what is at risk is the
+    // oldest write that has not been flushed.
+    void resize(Handle entry, size_t bytes) {
+        total.fetch_add(bytes - entry->bytes, std::memory_order_relaxed);  // Wraps correctly when shrinking
+        entry->bytes = bytes;
+    }
+
+    // The entry was written back by its owner, e.g. on eviction
+    void remove(Handle entry) {
+        total.fetch_sub(entry->bytes, std::memory_order_relaxed);
+        order.erase(entry);
+    }
+
+    // Adds an entry that was taken for flushing but failed to be written, in its place by
+    // dirty time. Failures are rare, so a walk from the oldest entry is fine.
+    Handle restore(const std::string &path, size_t bytes, Clock::time_point since) {
+        total.fetch_add(bytes, std::memory_order_relaxed);
+        auto position = order.begin();
+        while (position != order.end() && position->since <= since) {
+            ++position;
+        }
+        return order.insert(position, Entry{path, bytes, since});
+    }
+
+    // Removes and returns the entries due for flushing: everything dirty since before
+    // cutoff, then the oldest of the rest until excessBytes are taken (or all of them).
+    // Their bytes move to the in-flight count until written() releases them. They are
+    // added there first, so unflushed() never misses them on the way.
+    std::vector<Entry> takeDue(Clock::time_point cutoff, size_t excessBytes, bool all) {
+        std::vector<Entry> due;
+        size_t taken = 0;
+        while (!order.empty()) {
+            Entry &oldest = order.front();
+            if (!all && oldest.since > cutoff && taken >= excessBytes) {
+                break;
+            }
+            taken += oldest.bytes;
+            inFlight.fetch_add(oldest.bytes);
+            total.fetch_sub(oldest.bytes);
+            due.push_back(std::move(oldest));
+            order.pop_front();
+        }
+        return due;
+    }
+
+    // Bytes taken by takeDue have been written, or restored after a failure
+    void written(size_t bytes) {
+        inFlight.fetch_sub(bytes);
+    }
+
+    size_t bytes() const {
+        return total.load(std::memory_order_relaxed);
+    }
+
+    // Dirty plus in flight. Read in the order takeDue moves bytes, so nothing is missed.
+    size_t unflushed() const {
+        size_t dirty = total.load();
+        return dirty + inFlight.load();
+    }
+
+private:
+    std::list<Entry> order;
+    std::atomic<size_t> total{0};
+    std::atomic<size_t> inFlight{0};  // Taken by takeDue but not yet written
+};
+
+// Append-only log of written-back records with one fdatasync per batch, so a crash
+// loses at most the batch being written. Each record is a u32 path length, a u32 data
+// length, then the path and data bytes, in native byte order.
+class WriteBackJournal {
+public:
+    explicit WriteBackJournal(const std::string &fileName) {
+        fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("cannot open journal '" + fileName + "': " + strerror(errno));
+        }
+    }
+
+    ~WriteBackJournal() {
+        close(fd);
+    }
+
+    WriteBackJournal(const WriteBackJournal &) = delete;
+    WriteBackJournal &operator=(const WriteBackJournal &) = delete;
+
+    void append(const std::vector<DirtyRecord> &batch) {
+        std::lock_guard<std::mutex> guard(lock);
+        buffer.clear();
+        for (const DirtyRecord &record : batch) {
+            uint32_t lengths[2] = {static_cast<uint32_t>(record.path.size()), static_cast<uint32_t>(record.data.size())};
+            buffer.append(reinterpret_cast<const char *>(lengths), sizeof(lengths));
+            buffer.append(record.path);
+            buffer.append(record.data);
+        }
+
+        size_t done = 0;
+        while (done < buffer.size()) {
+            ssize_t n = write(fd, buffer.data() + done, buffer.size() - done);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(std::string("journal write: ") + strerror(errno));
+            }
+            done += n;
+        }
+        if (fdatasync(fd) < 0) {
+            throw std::runtime_error(std::string("journal fdatasync: ") + strerror(errno));
+        }
+    }
+
+private:
+    int fd;
+    std::mutex lock;
+    std::string buffer;  // Reused between batches
+};
+
+class WriteBackFlusher {
+public:
+    using Clock = DirtyTracker::Clock;
+    // Takes the due entries (see DirtyTracker::takeDue) and publishes them to the backing store
+    using Collect = std::function<std::vector<DirtyRecord>(Clock::time_point cutoff, size_t excessBytes, bool all)>;
+    // Makes one sorted batch durable; may be empty for an in-memory backing store
+    using Write = std::function<void(const std::vector<DirtyRecord> &batch)>;
+    // Takes back a batch the writer failed on, to be marked dirty again (see DirtyTracker::restore)
+    using Requeue = std::function<void(std::vector<DirtyRecord> batch)>;
+
+    WriteBackFlusher(const WriteBackOptions &options, DirtyTracker &tracker, Collect collect, Write write,
+                     Requeue requeue)
+        : options(options), tracker(tracker), collect(std::move(collect)), write(std::move(write)),
+          requeue(std::move(requeue)) {
+        if (this->options.lowWatermarkBytes > this->options.highWatermarkBytes) {
+            this->options.lowWatermarkBytes = this->options.highWatermarkBytes;
+        }
+        if (this->options.maxBatchEntries == 0) {
+            this->options.maxBatchEntries = 1;
+        }
+        worker = std::thread([this] { run(); });
+    }
+
+    // Stops the thread after flushing everything that is still dirty
+    ~WriteBackFlusher() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        drained.notify_all();
+        worker.join();
+    }
+
+    WriteBackFlusher(const WriteBackFlusher &) = delete;
+    WriteBackFlusher &operator=(const WriteBackFlusher &) = delete;
+
+    // Called by a writer before it dirties data, without holding the cache lock
+    void throttle() {
+        if (unflushed() < options.hardLimitBytes) {
+            return;
+        }
+        auto start = Clock::now();
+        std::unique_lock<std::mutex> guard(lock);
+        wakeup.notify_one();
+        drained.wait(guard, [this] { return stopping || unflushed() < options.hardLimitBytes; });
+        stats.stalls++;
+        stats.stallNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    }
+
+    // Called by a writer after it dirtied data; starts flushing early above the high watermark
+    void dirtied() {
+        if (unflushed() > options.highWatermarkBytes) {
+            wakeup.notify_one();
+        }
+    }
+
+    // Flushes every dirty entry from the calling thread
+    void flushAll() {
+        flush(true);
+    }
+
+    WriteBackStats statistics() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return stats;
+    }
+
+private:
+    WriteBackOptions options;
+    DirtyTracker &tracker;
+    Collect collect;
+    Write write;
+    Requeue requeue;
+    mutable std::mutex lock;
+    std::condition_variable wakeup, drained;
+    bool stopping = false;
+    WriteBackStats stats;
+    std::thread worker;
+
+    size_t unflushed() const {
+        return tracker.unflushed();
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> guard(lock);
+        while (!stopping) {
+            wakeup.wait_for(guard, options.interval,
+                            [this] { return stopping || unflushed() > options.highWatermarkBytes; });
+            guard.unlock();
+            flush(false);
+            guard.lock();
+        }
+        guard.unlock();
+        flush(true);
+    }
+
+    void flush(bool all) {
+        size_t pending = unflushed();
+        size_t excess = pending > options.highWatermarkBytes ? pending - options.lowWatermarkBytes : 0;
+        std::vector<DirtyRecord> records = collect(Clock::now() - options.maxAge, excess, all);
+        if (records.empty()) {
+            return;
+        }
+
+        // Adjacent paths end up in the same batch. Stable, so versions of one path keep the
+        // order collect gave them and the newest is journaled last.
+        std::stable_sort(records.begin(), records.end(),
+                  [](const DirtyRecord &a, const DirtyRecord &b) { return a.path < b.path; });
+
+        for (size_t first = 0; first < records.size(); first += options.maxBatchEntries) {
+            size_t last = std::min(records.size(), first + options.maxBatchEntries);
+            std::vector<DirtyRecord> batch(std::make_move_iterator(records.begin() + first),
+                                           std::make_move_iterator(records.begin() + last));
+            size_t bytes = 0, tracked = 0;
+            for (const DirtyRecord &record : batch) {
+                bytes += record.data.size();
+                tracked += record.trackedBytes;
+            }
+            size_t records = batch.size();
+
+            auto start = Clock::now();
+            bool failed = false;
+            try {
+                write(batch);
+            } catch (const std::exception &e) {
+                std::cerr << "Write-back failed: " << e.what() << std::endl;
+                failed = true;
+            }
+            long long nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+            if (failed) {
+                requeue(std::move(batch));  // Back in the tracker before leaving the in-flight count
+            }
+            tracker.written(tracked);
+
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stats.batches++;
+                stats.records += records;
+                stats.bytes += bytes;
+                stats.maxBatchRecords = std::max<long long>(stats.maxBatchRecords, records);
+                stats.flushNanos += nanos;
+                stats.maxFlushNanos = std::max(stats.maxFlushNanos, nanos);
+                if (failed) stats.failures++;
+            }
+            drained.notify_all();
+        }
+    }
+};
+
+#endif // WRITE_BACK_H